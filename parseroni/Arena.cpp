@@ -0,0 +1,80 @@
+#include "parseroni/Arena.h"
+
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+
+Arena::~Arena() {
+  for (auto b = head; b;) {
+    auto next = b->next;
+    free(b);
+    b = next;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void Arena::reset() {
+  current = head;
+  cursor = head ? head->begin() : nullptr;
+  limit  = head ? head->end()   : nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+size_t Arena::bytes_reserved() const {
+  size_t total = 0;
+  for (auto b = head; b; b = b->next) total += b->size;
+  return total;
+}
+
+size_t Arena::bytes_used() const {
+  if (!current) return 0;
+  size_t total = 0;
+  for (auto b = head; b != current; b = b->next) total += b->size;
+  return total + size_t(cursor - current->begin());
+}
+
+//------------------------------------------------------------------------------
+// Move on to the next block in the chain that fits, reusing blocks from
+// before the last reset() where possible. Oversized requests get a block of
+// their own.
+
+void* Arena::alloc_slow(size_t size, size_t align) {
+  size_t need = size + align;
+
+  Block* prev = current;
+  Block* next = current ? current->next : head;
+
+  while (next && next->size < need) {
+    prev = next;
+    next = next->next;
+  }
+
+  if (!next) {
+    size_t new_size = need > block_size ? need : block_size;
+    next = (Block*)malloc(sizeof(Block) + new_size);
+    if (!next) throw std::bad_alloc();
+    next->size = new_size;
+    next->next = nullptr;
+
+    if (prev) {
+      // Splice in after prev so the blocks we skipped stay reachable.
+      next->next = prev->next;
+      prev->next = next;
+    }
+    else {
+      head = next;
+    }
+  }
+
+  current = next;
+  cursor = current->begin();
+  limit  = current->end();
+
+  auto p = (char*)((uintptr_t(cursor) + align - 1) & ~uintptr_t(align - 1));
+  cursor = p + size;
+  return p;
+}
+
+//------------------------------------------------------------------------------
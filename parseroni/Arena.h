@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory_resource>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+//------------------------------------------------------------------------------
+// Bump-pointer allocator that owns every node built during a parse.
+//
+// Nothing allocated here is ever destroyed individually - reset() rewinds to
+// the first block in O(1) and keeps the blocks around for the next parse, the
+// destructor hands them back to the system. Anything that needs memory of its
+// own (like the children vector in PTranslationUnit) should get it from the
+// arena through the std::pmr interface so skipping its destructor leaks
+// nothing.
+
+class Arena : public std::pmr::memory_resource {
+public:
+
+  Arena(size_t block_size = 64 * 1024) : block_size(block_size) {}
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* alloc(size_t size, size_t align = alignof(max_align_t)) {
+    auto p = (uintptr_t(cursor) + align - 1) & ~uintptr_t(align - 1);
+    if (p + size > uintptr_t(limit)) return alloc_slow(size, align);
+    cursor = (char*)(p + size);
+    return (void*)p;
+  }
+
+  template<typename T, typename... Args>
+  T* create(Args&&... args) {
+    return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  void reset();
+
+  size_t bytes_reserved() const;
+
+  // Everything handed out since the last reset(), plus whatever was skipped
+  // at the ends of blocks.
+  size_t bytes_used() const;
+
+protected:
+
+  void* do_allocate(size_t size, size_t align) override {
+    return alloc(size, align);
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+
+  struct Block {
+    Block* next;
+    size_t size;
+    char* begin() { return (char*)(this + 1); }
+    char* end()   { return begin() + size; }
+  };
+
+  void* alloc_slow(size_t size, size_t align);
+
+  size_t block_size;
+  Block* head = nullptr;     // first block in the chain
+  Block* current = nullptr;  // block we're bumping in
+  char*  cursor = nullptr;
+  char*  limit = nullptr;
+};
+
+//------------------------------------------------------------------------------
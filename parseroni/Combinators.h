@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <functional>
+#include <stddef.h>
 
 #include "symlinks/Matcheroni/Matcheroni.h"
 
@@ -39,6 +40,13 @@ struct cspan {
   size_t size() const { return end - begin; }
   bool empty() const { return end == begin; }
 
+  void shift(ptrdiff_t delta) {
+    if (begin) {
+      begin += delta;
+      end += delta;
+    }
+  }
+
   cspan operator + (const cspan& b) const {
     if (end == b.begin) {
       return cspan(begin, b.end);
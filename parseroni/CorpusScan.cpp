@@ -0,0 +1,200 @@
+#include "parseroni/CorpusScan.h"
+
+#include "parseroni/Hash.h"
+#include "parseroni/MappedFile.h"
+#include "parseroni/WorkPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+using rdit = fs::recursive_directory_iterator;
+
+//------------------------------------------------------------------------------
+
+static double now_seconds() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------------------------------
+
+void CorpusStats::merge(const CorpusStats& b) {
+  total_files  += b.total_files;
+  source_files += b.source_files;
+  failed_files += b.failed_files;
+  total_bytes  += b.total_bytes;
+  total_tokens += b.total_tokens;
+  cache_hits   += b.cache_hits;
+  for (int i = 0; i < LEX_TYPE_COUNT; i++) hit_counts[i] += b.hit_counts[i];
+  files.insert(files.end(), b.files.begin(), b.files.end());
+}
+
+//------------------------------------------------------------------------------
+
+static bool has_extension(const std::string& path, const CorpusOptions& options) {
+  for (auto& ext : options.extensions) {
+    if (path.ends_with(ext)) return true;
+  }
+  return false;
+}
+
+std::vector<CorpusFile> find_corpus_files(const std::vector<std::string>& paths,
+                                          const CorpusOptions& options,
+                                          CorpusStats& stats) {
+  std::vector<CorpusFile> files;
+  std::error_code err;
+
+  auto add = [&](const fs::directory_entry& f) {
+    if (!f.is_regular_file(err)) return;
+    stats.total_files++;
+    auto& path = f.path().native();
+    if (has_extension(path, options)) {
+      files.push_back({path, size_t(f.file_size(err))});
+    }
+  };
+
+  for (auto& path : paths) {
+    fs::directory_entry entry(path, err);
+    if (entry.is_directory(err)) {
+      for (const auto& f : rdit(path, fs::directory_options::skip_permission_denied, err)) {
+        add(f);
+      }
+    }
+    else {
+      add(entry);
+    }
+  }
+
+  // Biggest first so the long poles start early. Ties broken by path so the
+  // order is the same every run.
+  std::sort(files.begin(), files.end(), [](const CorpusFile& a, const CorpusFile& b) {
+    return a.size != b.size ? a.size > b.size : a.path < b.path;
+  });
+
+  return files;
+}
+
+//------------------------------------------------------------------------------
+
+bool lex_file(const char* path, TokenBuffer& tokens, FileResult& result) {
+  double start = now_seconds();
+
+  result.path = path;
+
+  MappedFile file;
+  if (!file.open(path)) {
+    tokens.clear();
+    result.ok = false;
+    result.seconds = now_seconds() - start;
+    return false;
+  }
+
+  result.ok = lex_all(file.data, file.size, tokens);
+  result.bytes = file.size;
+  result.tokens = tokens.size();
+  result.error_offset = result.ok ? 0 : tokens.begin_of(tokens.size());
+  result.seconds = now_seconds() - start;
+  return result.ok;
+}
+
+//------------------------------------------------------------------------------
+
+bool lex_file(const char* path, const TokenCache& cache, TokenBuffer& tokens,
+              CachedTokens& cached, FileResult& result) {
+  double start = now_seconds();
+
+  result.path = path;
+  result.cached = false;
+
+  MappedFile file;
+  if (!file.open(path)) {
+    tokens.clear();
+    result.ok = false;
+    result.seconds = now_seconds() - start;
+    return false;
+  }
+
+  // Hashing runs at memory speed, lexing doesn't.
+  auto hash = hash64(file.data, file.size);
+
+  if (cache.lookup(hash, file.size, cached)) {
+    result.cached = true;
+    result.ok = cached.ok;
+    result.error_offset = cached.error_offset;
+    result.tokens = cached.size();
+  }
+  else {
+    result.ok = lex_all(file.data, file.size, tokens);
+    result.error_offset = result.ok ? 0 : tokens.begin_of(tokens.size());
+    result.tokens = tokens.size();
+    cache.store(hash, file.size, tokens, result.ok, result.error_offset);
+  }
+
+  result.bytes = file.size;
+  result.seconds = now_seconds() - start;
+  return result.ok;
+}
+
+//------------------------------------------------------------------------------
+
+CorpusStats scan_corpus(const std::vector<std::string>& paths, const CorpusOptions& options) {
+  double start = now_seconds();
+
+  CorpusStats stats;
+  auto files = find_corpus_files(paths, options, stats);
+
+  TokenCache cache;
+  if (!options.cache_dir.empty()) cache.open(options.cache_dir);
+
+  WorkPool pool(options.threads);
+
+  // Everything a thread produces stays in its own slot until the merge.
+  struct ThreadState {
+    CorpusStats stats;
+    TokenBuffer tokens;
+  };
+  std::vector<ThreadState> threads(pool.thread_count());
+
+  for (auto& f : files) {
+    pool.push([&f, &threads, &cache](int thread) {
+      auto& state = threads[thread];
+      FileResult result;
+      CachedTokens cached;
+
+      if (cache.is_open()) {
+        lex_file(f.path.c_str(), cache, state.tokens, cached, result);
+      }
+      else {
+        lex_file(f.path.c_str(), state.tokens, result);
+      }
+
+      if (result.cached) {
+        for (size_t i = 0; i < cached.size(); i++) state.stats.hit_counts[cached.types[i]]++;
+        state.stats.cache_hits++;
+      }
+      else {
+        for (auto type : state.tokens.types) state.stats.hit_counts[type]++;
+      }
+      state.stats.source_files++;
+      state.stats.failed_files += result.ok ? 0 : 1;
+      state.stats.total_bytes  += result.bytes;
+      state.stats.total_tokens += result.tokens;
+      state.stats.files.push_back(std::move(result));
+    });
+  }
+  pool.wait();
+
+  for (auto& t : threads) stats.merge(t.stats);
+
+  std::sort(stats.files.begin(), stats.files.end(), [](const FileResult& a, const FileResult& b) {
+    return a.path < b.path;
+  });
+
+  stats.seconds = now_seconds() - start;
+  return stats;
+}
+
+//------------------------------------------------------------------------------
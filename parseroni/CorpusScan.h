@@ -0,0 +1,73 @@
+#pragma once
+
+#include "parseroni/Lexer.h"
+#include "parseroni/TokenCache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Lexes every source file under a set of files/directories on all cores,
+// optionally skipping files whose tokens are already in a TokenCache.
+
+struct CorpusOptions {
+  int threads = 0; // <= 0 means one per core
+  std::vector<std::string> extensions = { ".h", ".c", ".cpp" };
+  std::string cache_dir;  // TokenCache directory, empty for no cache
+};
+
+struct CorpusFile {
+  std::string path;
+  size_t size = 0;
+};
+
+struct FileResult {
+  std::string path;
+  size_t   bytes = 0;
+  size_t   tokens = 0;
+  bool     ok = false;
+  uint32_t error_offset = 0; // where lexing stopped, if !ok
+  double   seconds = 0;
+  bool     cached = false;   // tokens came from the cache, not the lexer
+};
+
+struct CorpusStats {
+  void merge(const CorpusStats& b);
+
+  size_t total_files = 0;  // every regular file seen, source or not
+  size_t source_files = 0;
+  size_t failed_files = 0;
+  size_t total_bytes = 0;
+  size_t total_tokens = 0;
+  size_t cache_hits = 0;
+  double seconds = 0;      // wall clock for the whole scan
+
+  uint64_t hit_counts[LEX_TYPE_COUNT] = {0};
+
+  // One per source file, sorted by path.
+  std::vector<FileResult> files;
+};
+
+// Source files under 'paths', largest first. Paths can be files or
+// directories. Bumps stats.total_files for every regular file seen.
+std::vector<CorpusFile> find_corpus_files(const std::vector<std::string>& paths,
+                                          const CorpusOptions& options,
+                                          CorpusStats& stats);
+
+// Maps and lexes one file.
+bool lex_file(const char* path, TokenBuffer& tokens, FileResult& result);
+
+// Same, through a token cache. On a hit the tokens are read in place from the
+// mapped entry in 'cached' and 'tokens' is left alone. On a miss the file is
+// lexed into 'tokens' and stored for next time.
+bool lex_file(const char* path, const TokenCache& cache, TokenBuffer& tokens,
+              CachedTokens& cached, FileResult& result);
+
+// Lexes everything. Results don't depend on the thread count or on which
+// thread got which file, apart from the timings.
+CorpusStats scan_corpus(const std::vector<std::string>& paths,
+                        const CorpusOptions& options = CorpusOptions());
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,86 @@
+#include "parseroni/Hash.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t P1 = 11400714785074694791ull;
+static const uint64_t P2 = 14029467366897019727ull;
+static const uint64_t P3 = 1609587929392839161ull;
+static const uint64_t P4 = 9650029242287828579ull;
+static const uint64_t P5 = 2870177450012600261ull;
+
+static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t read64(const uint8_t* p) { uint64_t x; memcpy(&x, p, 8); return x; }
+static inline uint32_t read32(const uint8_t* p) { uint32_t x; memcpy(&x, p, 4); return x; }
+
+static inline uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * P2;
+  acc = rotl(acc, 31);
+  return acc * P1;
+}
+
+static inline uint64_t merge(uint64_t acc, uint64_t val) {
+  acc ^= round(0, val);
+  return acc * P1 + P4;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+  auto p = (const uint8_t*)data;
+  auto end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + P1 + P2;
+    uint64_t v2 = seed + P2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - P1;
+
+    // Four independent lanes, so the multiplies overlap.
+    for (; end - p >= 32; p += 32) {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+    }
+
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge(h, v1);
+    h = merge(h, v2);
+    h = merge(h, v3);
+    h = merge(h, v4);
+  }
+  else {
+    h = seed + P5;
+  }
+
+  h += size;
+
+  for (; end - p >= 8; p += 8) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * P1 + P4;
+  }
+
+  if (end - p >= 4) {
+    h ^= uint64_t(read32(p)) * P1;
+    h = rotl(h, 23) * P2 + P3;
+    p += 4;
+  }
+
+  for (; p < end; p++) {
+    h ^= *p * P5;
+    h = rotl(h, 11) * P1;
+  }
+
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+//------------------------------------------------------------------------------
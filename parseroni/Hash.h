@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// XXH64 - fast, well distributed, and a published format, so hashes written
+// to disk by one build can be checked by another (or by the xxhsum tool).
+// Several GB/s, which is noise next to lexing the same bytes.
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,356 @@
+#include "parseroni/IncludeGraph.h"
+
+#include "parseroni/CorpusScan.h"
+#include "parseroni/Lexer.h"
+#include "parseroni/Parser.h"
+#include "parseroni/WorkPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sys/stat.h>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+//------------------------------------------------------------------------------
+
+static double now_seconds() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string normalize(const std::string& path) {
+  std::error_code err;
+  return fs::absolute(path, err).lexically_normal().string();
+}
+
+//------------------------------------------------------------------------------
+// String-keyed map split over several locks, so threads resolving different
+// names don't queue up behind each other.
+
+template<typename V>
+struct ShardedMap {
+  static const int shard_count = 16;
+
+  bool find(const std::string& key, V& out) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> guard(s.lock);
+    auto it = s.map.find(key);
+    if (it == s.map.end()) return false;
+    out = it->second;
+    return true;
+  }
+
+  // Keeps whichever value got there first and returns it.
+  V insert(const std::string& key, const V& value) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> guard(s.lock);
+    return s.map.try_emplace(key, value).first->second;
+  }
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_map<std::string, V> map;
+  };
+
+  Shard& shard(const std::string& key) {
+    return shards[std::hash<std::string>()(key) % shard_count];
+  }
+
+  Shard shards[shard_count];
+};
+
+//------------------------------------------------------------------------------
+// Nodes are numbered in the order they're found, which depends on the thread
+// timing - build_include_graph() renumbers them by path at the end.
+
+struct GraphBuilder {
+  GraphBuilder(const IncludeOptions& options) : options(options), pool(options.threads) {
+    for (int i = 0; i < pool.thread_count(); i++) threads.push_back(std::make_unique<ThreadState>());
+  }
+
+  uint32_t add_node(const std::string& path, bool root);
+  void     parse(IncludeNode& node, int thread);
+  uint32_t resolve(const std::string& dir, const std::string& name, bool angled);
+  bool     is_file(const std::string& path);
+
+  const IncludeOptions& options;
+  WorkPool pool;
+
+  struct ThreadState {
+    Parser      parser;
+    TokenBuffer tokens;
+  };
+  std::vector<std::unique_ptr<ThreadState>> threads;
+
+  // Only grows, under node_lock. The nodes themselves never move, so a task
+  // can hold on to its node without the lock.
+  std::mutex node_lock;
+  std::unordered_map<std::string, uint32_t> node_ids;
+  std::vector<std::unique_ptr<IncludeNode>> nodes;
+
+  ShardedMap<bool>     stat_cache;     // path -> is a regular file
+  ShardedMap<uint32_t> resolve_cache;  // (dir, name) -> node
+
+  std::atomic<size_t> stat_calls = 0;
+  std::atomic<size_t> resolve_calls = 0;
+  std::atomic<size_t> resolve_hits = 0;
+};
+
+//------------------------------------------------------------------------------
+// The first thread to add a path is the one that queues its parse, so every
+// file is parsed exactly once however many includers race to it.
+
+uint32_t GraphBuilder::add_node(const std::string& path, bool root) {
+  IncludeNode* node = nullptr;
+  uint32_t id;
+  {
+    std::lock_guard<std::mutex> guard(node_lock);
+    auto [it, added] = node_ids.try_emplace(path, uint32_t(nodes.size()));
+    id = it->second;
+    if (!added) {
+      if (root) nodes[id]->root = true;
+      return id;
+    }
+    nodes.push_back(std::make_unique<IncludeNode>());
+    node = nodes.back().get();
+    node->path = path;
+    node->root = root;
+  }
+
+  pool.push([this, node](int thread) { parse(*node, thread); });
+  return id;
+}
+
+//------------------------------------------------------------------------------
+
+bool GraphBuilder::is_file(const std::string& path) {
+  bool result;
+  if (stat_cache.find(path, result)) return result;
+
+  stat_calls++;
+  struct stat st;
+  result = ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+  return stat_cache.insert(path, result);
+}
+
+// Quoted names depend on where the includer lives, angled names don't, so
+// <stdio.h> is looked up once for the whole tree.
+
+uint32_t GraphBuilder::resolve(const std::string& dir, const std::string& name, bool angled) {
+  resolve_calls++;
+
+  auto key = angled ? "<" + name : dir + '\0' + name;
+  uint32_t id;
+  if (resolve_cache.find(key, id)) {
+    resolve_hits++;
+    return id;
+  }
+
+  id = IncludeGraph::unresolved;
+  auto try_dir = [&](const std::string& d) {
+    if (id != IncludeGraph::unresolved) return;
+    auto path = d.empty() ? name : d + "/" + name;
+    if (is_file(path)) id = add_node(normalize(path), false);
+  };
+
+  if (!name.empty() && name[0] == '/') {
+    try_dir("");
+  }
+  else {
+    if (!angled) {
+      try_dir(dir);
+      for (auto& d : options.quote_dirs) try_dir(d);
+    }
+    for (auto& d : options.search_dirs) try_dir(d);
+  }
+
+  return resolve_cache.insert(key, id);
+}
+
+//------------------------------------------------------------------------------
+// The lexer finds the directives - so an #include inside a comment or a string
+// doesn't count - and take_preproc_include() picks each one apart. Only a '#'
+// that starts its line (comments and whitespace aside) is a directive.
+
+void GraphBuilder::parse(IncludeNode& node, int thread) {
+  auto& state = *threads[thread];
+  auto& p = state.parser;
+  auto& tokens = state.tokens;
+
+  if (!p.load_file(node.path.c_str())) return;
+  node.ok = true;
+
+  lex_all(p.source_start, p.source_end - p.source_start, tokens);
+
+  auto dir = fs::path(node.path).parent_path().string();
+  bool line_start = true;
+
+  for (size_t i = 0; i < tokens.size(); i++) {
+    auto type = LexType(tokens.types[i]);
+
+    if (type == LEX_NEWLINE) {
+      line_start = true;
+      continue;
+    }
+    if (type == LEX_SPACE || type == LEX_COMMENT1 || type == LEX_COMMENT2 || type == LEX_SPLICE) continue;
+
+    if (type == LEX_PREPROC && line_start) {
+      p.cursor = p.source_start + tokens.begin_of(i);
+      if (auto include = p.take_preproc_include()) {
+        auto path = include->lit_path;
+
+        IncludeEdge edge;
+        edge.angled = path.begin[0] == '<';
+        edge.name.assign(path.begin + 1, path.end - 1);
+        edge.line = p.locate(include->span.begin).line;
+        edge.target = resolve(dir, edge.name, edge.angled);
+        node.includes.push_back(std::move(edge));
+      }
+    }
+
+    line_start = false;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+IncludeGraph build_include_graph(const std::vector<std::string>& roots, const IncludeOptions& options) {
+  double start = now_seconds();
+
+  GraphBuilder builder(options);
+
+  CorpusOptions corpus;
+  corpus.extensions = options.extensions;
+  CorpusStats unused;
+  for (auto& f : find_corpus_files(roots, corpus, unused)) {
+    builder.add_node(normalize(f.path), true);
+  }
+  builder.pool.wait();
+
+  //----------------------------------------
+  // Renumber by path.
+
+  auto& found = builder.nodes;
+  std::vector<uint32_t> order(found.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return found[a]->path < found[b]->path;
+  });
+
+  std::vector<uint32_t> remap(found.size());
+  for (size_t i = 0; i < order.size(); i++) remap[order[i]] = uint32_t(i);
+
+  IncludeGraph graph;
+  graph.nodes.reserve(found.size());
+  for (auto i : order) graph.nodes.push_back(std::move(*found[i]));
+
+  for (auto& node : graph.nodes) {
+    for (auto& edge : node.includes) {
+      if (edge.target == IncludeGraph::unresolved) {
+        graph.unresolved_count++;
+      }
+      else {
+        edge.target = remap[edge.target];
+        graph.edge_count++;
+      }
+    }
+  }
+
+  graph.stat_calls    = builder.stat_calls;
+  graph.resolve_calls = builder.resolve_calls;
+  graph.resolve_hits  = builder.resolve_hits;
+  graph.seconds       = now_seconds() - start;
+  return graph;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t IncludeGraph::find(const std::string& path) const {
+  auto it = std::lower_bound(nodes.begin(), nodes.end(), path, [](const IncludeNode& n, const std::string& p) {
+    return n.path < p;
+  });
+  return (it != nodes.end() && it->path == path) ? uint32_t(it - nodes.begin()) : unresolved;
+}
+
+std::vector<uint32_t> IncludeGraph::reachable(uint32_t node, bool reverse) const {
+  std::vector<std::vector<uint32_t>> includers;
+  if (reverse) {
+    includers.resize(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      for (auto& e : nodes[i].includes) {
+        if (e.target != unresolved) includers[e.target].push_back(i);
+      }
+    }
+  }
+
+  std::vector<bool> seen(nodes.size());
+  std::vector<uint32_t> result;
+  std::vector<uint32_t> stack = { node };
+
+  while (!stack.empty()) {
+    auto n = stack.back();
+    stack.pop_back();
+
+    auto visit = [&](uint32_t next) {
+      if (next == unresolved || seen[next]) return;
+      seen[next] = true;
+      result.push_back(next);
+      stack.push_back(next);
+    };
+
+    if (reverse) {
+      for (auto i : includers[n]) visit(i);
+    }
+    else {
+      for (auto& e : nodes[n].includes) visit(e.target);
+    }
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+//------------------------------------------------------------------------------
+
+void IncludeGraph::write_edges(FILE* out) const {
+  for (auto& node : nodes) {
+    for (auto& e : node.includes) {
+      if (e.target != unresolved) {
+        fprintf(out, "%s %s\n", node.path.c_str(), nodes[e.target].path.c_str());
+      }
+      else {
+        fprintf(out, "%s ?%c%s%c\n", node.path.c_str(), e.angled ? '<' : '"', e.name.c_str(), e.angled ? '>' : '"');
+      }
+    }
+  }
+}
+
+void IncludeGraph::write_dot(FILE* out) const {
+  auto quoted = [](const std::string& s) {
+    std::string r = "\"";
+    for (auto c : s) {
+      if (c == '"' || c == '\\') r.push_back('\\');
+      r.push_back(c);
+    }
+    return r + "\"";
+  };
+
+  fprintf(out, "digraph includes {\n");
+  for (size_t i = 0; i < nodes.size(); i++) {
+    fprintf(out, "  n%zu [label=%s%s];\n", i, quoted(nodes[i].path).c_str(), nodes[i].root ? " shape=box" : "");
+  }
+  for (size_t i = 0; i < nodes.size(); i++) {
+    for (auto& e : nodes[i].includes) {
+      if (e.target != unresolved) fprintf(out, "  n%zu -> n%u;\n", i, e.target);
+    }
+  }
+  fprintf(out, "}\n");
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Follows #include lines from a set of root files and builds the include graph
+// of everything they reach, on all cores.
+//
+// Every #include in a file is an edge, whatever #if it's under - this is the
+// graph a build system has to assume, not what one particular configuration
+// sees. Includes are resolved the way compilers do it: "quoted" names try the
+// including file's directory, then quote_dirs, then search_dirs; <angled>
+// names only try search_dirs. Anything not found stays in the graph as an
+// unresolved edge.
+
+struct IncludeOptions {
+  std::vector<std::string> quote_dirs;   // like -iquote
+  std::vector<std::string> search_dirs;  // like -I, in order
+  std::vector<std::string> extensions = { ".h", ".c", ".cpp" };  // for directory roots
+  int threads = 0;  // <= 0 means one per core
+};
+
+struct IncludeEdge {
+  uint32_t    target;   // node index, or IncludeGraph::unresolved
+  uint32_t    line;     // 1-based line of the #include
+  bool        angled;
+  std::string name;     // as written, without the quotes or brackets
+};
+
+struct IncludeNode {
+  std::string path;     // absolute and normalized
+  bool        root = false;
+  bool        ok = false;  // the file could be read
+  std::vector<IncludeEdge> includes;  // in the order they appear
+};
+
+struct IncludeGraph {
+  static const uint32_t unresolved = UINT32_MAX;
+
+  // Node index for an absolute normalized path, or unresolved.
+  uint32_t find(const std::string& path) const;
+
+  // Every node reachable from 'node' - what it includes, directly or not - or
+  // with 'reverse', every node that reaches it, i.e. everything that has to
+  // rebuild when it changes. Sorted, and doesn't include 'node' itself unless
+  // there's a cycle through it.
+  std::vector<uint32_t> reachable(uint32_t node, bool reverse = false) const;
+
+  // "includer included" per resolved edge, or "includer <name>" with a '?'
+  // in front for unresolved ones.
+  void write_edges(FILE* out) const;
+
+  // Graphviz.
+  void write_dot(FILE* out) const;
+
+  // Sorted by path, so the graph is the same whatever the thread count.
+  std::vector<IncludeNode> nodes;
+
+  size_t edge_count = 0;
+  size_t unresolved_count = 0;
+  size_t stat_calls = 0;      // filesystem lookups that missed the cache
+  size_t resolve_calls = 0;   // #includes resolved
+  size_t resolve_hits = 0;    // ...that were answered from the cache
+  double seconds = 0;
+};
+
+// Roots can be files or directories.
+IncludeGraph build_include_graph(const std::vector<std::string>& roots,
+                                 const IncludeOptions& options = IncludeOptions());
+
+//------------------------------------------------------------------------------
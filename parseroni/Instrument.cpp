@@ -0,0 +1,188 @@
+#include "parseroni/Instrument.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+
+//------------------------------------------------------------------------------
+// Without PARSERONI_INSTRUMENT there are no probes, so none of the per-thread
+// machinery below exists - not even the thread_local counter block.
+
+#ifdef PARSERONI_INSTRUMENT
+
+static const int max_probes = 256;
+
+struct ProbeCounters {
+  // Only ever written by the owning thread, so relaxed load+store is enough
+  // and keeps the hot path free of locked instructions.
+  std::atomic<uint64_t> attempts;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> hit_cycles;
+  std::atomic<uint64_t> miss_cycles;
+};
+
+struct ThreadBlock {
+  ThreadBlock();
+  ~ThreadBlock();
+  ProbeCounters counters[max_probes] = {};
+};
+
+struct Registry {
+  std::mutex lock;
+  std::vector<std::string> names;       // by probe index
+  std::vector<ThreadBlock*> threads;    // live threads
+  std::vector<ProbeStats> retired;      // by probe index, from dead threads
+};
+
+static Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+static thread_local ThreadBlock tls_block;
+
+//------------------------------------------------------------------------------
+
+ThreadBlock::ThreadBlock() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  r.threads.push_back(this);
+}
+
+ThreadBlock::~ThreadBlock() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+
+  r.retired.resize(r.names.size());
+  for (size_t i = 0; i < r.names.size(); i++) {
+    auto& c = counters[i];
+    r.retired[i].attempts    += c.attempts.load(std::memory_order_relaxed);
+    r.retired[i].hits        += c.hits.load(std::memory_order_relaxed);
+    r.retired[i].hit_cycles  += c.hit_cycles.load(std::memory_order_relaxed);
+    r.retired[i].miss_cycles += c.miss_cycles.load(std::memory_order_relaxed);
+  }
+
+  r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+}
+
+//------------------------------------------------------------------------------
+
+Probe::Probe(const char* name) {
+  auto& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  index = int(r.names.size());
+  if (index >= max_probes) {
+    fprintf(stderr, "Too many probes, dropping %s\n", name);
+    index = -1;
+    return;
+  }
+  r.names.push_back(name);
+}
+
+static void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void probe_record(const Probe& probe, bool hit, uint64_t cycles) {
+  if (probe.index < 0) return;
+  auto& c = tls_block.counters[probe.index];
+  bump(c.attempts, 1);
+  if (hit) {
+    bump(c.hits, 1);
+    bump(c.hit_cycles, cycles);
+  }
+  else {
+    bump(c.miss_cycles, cycles);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Several probes can share a name (one per template instantiation, say), so
+// the totals are keyed by name.
+
+std::vector<ProbeStats> instrument_snapshot() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+
+  std::map<std::string, ProbeStats> by_name;
+
+  for (size_t i = 0; i < r.names.size(); i++) {
+    auto& s = by_name[r.names[i]];
+    s.name = r.names[i];
+
+    if (i < r.retired.size()) {
+      s.attempts    += r.retired[i].attempts;
+      s.hits        += r.retired[i].hits;
+      s.hit_cycles  += r.retired[i].hit_cycles;
+      s.miss_cycles += r.retired[i].miss_cycles;
+    }
+
+    for (auto t : r.threads) {
+      auto& c = t->counters[i];
+      s.attempts    += c.attempts.load(std::memory_order_relaxed);
+      s.hits        += c.hits.load(std::memory_order_relaxed);
+      s.hit_cycles  += c.hit_cycles.load(std::memory_order_relaxed);
+      s.miss_cycles += c.miss_cycles.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<ProbeStats> result;
+  for (auto& [name, s] : by_name) result.push_back(s);
+
+  std::sort(result.begin(), result.end(), [](const ProbeStats& a, const ProbeStats& b) {
+    return a.hit_cycles + a.miss_cycles > b.hit_cycles + b.miss_cycles;
+  });
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Only meant to be called while nothing else is probing.
+
+void instrument_reset() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+
+  r.retired.clear();
+  for (auto t : r.threads) {
+    for (auto& c : t->counters) {
+      c.attempts.store(0, std::memory_order_relaxed);
+      c.hits.store(0, std::memory_order_relaxed);
+      c.hit_cycles.store(0, std::memory_order_relaxed);
+      c.miss_cycles.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+#else
+
+std::vector<ProbeStats> instrument_snapshot() {
+  return {};
+}
+
+void instrument_reset() {
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+
+void instrument_report(FILE* out) {
+  auto stats = instrument_snapshot();
+  if (stats.empty()) {
+    fprintf(out, "no probes (build with -DPARSERONI_INSTRUMENT)\n");
+    return;
+  }
+
+  fprintf(out, "%-28s %12s %12s %7s %14s %14s %10s\n",
+          "probe", "attempts", "hits", "hit%", "hit cycles", "miss cycles", "cyc/miss");
+  for (auto& s : stats) {
+    fprintf(out, "%-28s %12lu %12lu %6.1f%% %14lu %14lu %10.1f\n",
+            s.name.c_str(), s.attempts, s.hits,
+            s.attempts ? 100.0 * s.hits / s.attempts : 0.0,
+            s.hit_cycles, s.miss_cycles,
+            s.attempts > s.hits ? double(s.miss_cycles) / (s.attempts - s.hits) : 0.0);
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Per-matcher / per-rule counters: attempts, hits, and cycles spent on hits
+// and on misses. Build with -DPARSERONI_INSTRUMENT to turn them on - without
+// it PROBE_MATCHER and PROBE_CALL expand to the bare matcher/expression and
+// cost nothing.
+//
+// Counters live in per-thread blocks, so probing from many threads at once
+// needs no locks or atomic read-modify-writes on the hot path.
+// instrument_snapshot() sums every live thread plus the threads that have
+// already exited.
+
+struct ProbeStats {
+  std::string name;
+  uint64_t attempts = 0;
+  uint64_t hits = 0;
+  uint64_t hit_cycles = 0;
+  uint64_t miss_cycles = 0;
+};
+
+// Totals per probe name, most expensive first.
+std::vector<ProbeStats> instrument_snapshot();
+void instrument_report(FILE* out = stdout);
+void instrument_reset();
+
+//------------------------------------------------------------------------------
+
+#ifdef PARSERONI_INSTRUMENT
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline uint64_t probe_clock() { return __rdtsc(); }
+#else
+#include <chrono>
+inline uint64_t probe_clock() {
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+#endif
+
+template<size_t N>
+struct ProbeName {
+  constexpr ProbeName(const char (&s)[N]) {
+    for (size_t i = 0; i < N; i++) str[i] = s[i];
+  }
+  char str[N];
+};
+
+// One per instrumented site. Registers itself on first use.
+struct Probe {
+  Probe(const char* name);
+  int index;
+};
+
+void probe_record(const Probe& probe, bool hit, uint64_t cycles);
+
+template<ProbeName name, typename F>
+inline auto probe_call(F&& f) {
+  static Probe probe(name.str);
+  auto start = probe_clock();
+  auto result = f();
+  probe_record(probe, bool(result), probe_clock() - start);
+  return result;
+}
+
+template<auto F, ProbeName name>
+const char* probed_matcher(const char* text) {
+  return probe_call<name>([text]() { return F(text); });
+}
+
+#define PROBE_MATCHER(F)       (&probed_matcher<F, #F>)
+#define PROBE_CALL(NAME, EXPR) (probe_call<NAME>([&]() { return (EXPR); }))
+
+#else
+
+#define PROBE_MATCHER(F)       (F)
+#define PROBE_CALL(NAME, EXPR) (EXPR)
+
+#endif
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <initializer_list>
+
+//------------------------------------------------------------------------------
+// C11 keywords, in the order the standard lists them. KW_NONE means "plain
+// identifier".
+
+enum Keyword : uint8_t {
+  KW_NONE = 0,
+  KW_AUTO, KW_BREAK, KW_CASE, KW_CHAR, KW_CONST, KW_CONTINUE, KW_DEFAULT, KW_DO,
+  KW_DOUBLE, KW_ELSE, KW_ENUM, KW_EXTERN, KW_FLOAT, KW_FOR, KW_GOTO, KW_IF,
+  KW_INLINE, KW_INT, KW_LONG, KW_REGISTER, KW_RESTRICT, KW_RETURN, KW_SHORT,
+  KW_SIGNED, KW_SIZEOF, KW_STATIC, KW_STRUCT, KW_SWITCH, KW_TYPEDEF, KW_UNION,
+  KW_UNSIGNED, KW_VOID, KW_VOLATILE, KW_WHILE, KW_ALIGNAS, KW_ALIGNOF,
+  KW_ATOMIC, KW_BOOL, KW_COMPLEX, KW_GENERIC, KW_IMAGINARY, KW_NORETURN,
+  KW_STATIC_ASSERT, KW_THREAD_LOCAL,
+  KW_COUNT,
+};
+
+// Indexed by Keyword.
+inline constexpr const char* keyword_names[KW_COUNT] = {
+  "",
+  "auto", "break", "case", "char", "const", "continue", "default", "do",
+  "double", "else", "enum", "extern", "float", "for", "goto", "if",
+  "inline", "int", "long", "register", "restrict", "return", "short",
+  "signed", "sizeof", "static", "struct", "switch", "typedef", "union",
+  "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof",
+  "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary", "_Noreturn",
+  "_Static_assert", "_Thread_local",
+};
+
+//------------------------------------------------------------------------------
+// Keyword sets as bitmasks, for the grammar rules that accept "any of these".
+
+using KeywordSet = uint64_t;
+static_assert(KW_COUNT <= 64);
+
+constexpr KeywordSet keyword_set(std::initializer_list<Keyword> keywords) {
+  KeywordSet set = 0;
+  for (auto k : keywords) set |= KeywordSet(1) << k;
+  return set;
+}
+
+inline constexpr KeywordSet kw_storage_class = keyword_set({
+  KW_AUTO, KW_REGISTER, KW_STATIC, KW_EXTERN, KW_TYPEDEF, KW_THREAD_LOCAL });
+
+inline constexpr KeywordSet kw_type_qualifier = keyword_set({
+  KW_CONST, KW_VOLATILE, KW_RESTRICT, KW_ATOMIC });
+
+inline constexpr KeywordSet kw_primitive_type = keyword_set({
+  KW_VOID, KW_CHAR, KW_SHORT, KW_INT, KW_LONG, KW_FLOAT, KW_DOUBLE, KW_BOOL,
+  KW_COMPLEX });
+
+inline constexpr KeywordSet kw_signed = keyword_set({ KW_SIGNED, KW_UNSIGNED });
+
+//------------------------------------------------------------------------------
+// Perfect hash over the keywords, found at compile time. The key packs the
+// length with the first two and last two bytes - every keyword is at least two
+// bytes long, so those reads never leave the span - and a multiplicative hash
+// with a searched-for seed spreads the keys over 256 slots with no collisions.
+// A lookup is one multiply, one table load, and one memcmp against the only
+// keyword that could possibly match.
+
+struct KeywordHash {
+  static const size_t min_len = 2;
+  static const size_t max_len = 14;
+
+  static constexpr uint32_t key(const char* s, size_t len) {
+    return (uint32_t(uint8_t(s[0]))       << 0)  ^
+           (uint32_t(uint8_t(s[1]))       << 8)  ^
+           (uint32_t(uint8_t(s[len - 2])) << 16) ^
+           (uint32_t(uint8_t(s[len - 1])) << 24) ^
+           uint32_t(len * 0x9E3779B9u);
+  }
+
+  static constexpr uint8_t slot(uint32_t key, uint32_t seed) {
+    return uint8_t((key * seed) >> 24);
+  }
+
+  constexpr KeywordHash() : seed(0), slots{}, lens{} {
+    for (int k = 1; k < KW_COUNT; k++) lens[k] = uint8_t(__builtin_strlen(keyword_names[k]));
+    for (uint32_t s = 0x9E3779B1u; s; s += 2) {
+      if (try_seed(s)) {
+        seed = s;
+        return;
+      }
+    }
+  }
+
+  constexpr bool try_seed(uint32_t s) {
+    for (auto& x : slots) x = KW_NONE;
+    for (int k = 1; k < KW_COUNT; k++) {
+      auto h = slot(key(keyword_names[k], lens[k]), s);
+      if (slots[h] != KW_NONE) return false;
+      slots[h] = uint8_t(k);
+    }
+    return true;
+  }
+
+  Keyword classify(const char* s, size_t len) const {
+    if (len < min_len || len > max_len) return KW_NONE;
+    auto k = Keyword(slots[slot(key(s, len), seed)]);
+    return (lens[k] == len && memcmp(s, keyword_names[k], len) == 0) ? k : KW_NONE;
+  }
+
+  uint32_t seed;
+  uint8_t  slots[256];
+  uint8_t  lens[KW_COUNT];  // lens[KW_NONE] == 0 never matches
+};
+
+inline constexpr KeywordHash keyword_hash;
+static_assert(keyword_hash.seed != 0, "no perfect hash seed for the keyword table");
+
+// Classifies an identifier span. Anything that isn't exactly a keyword -
+// including a keyword prefix like "int" in "integer" - is KW_NONE.
+inline Keyword classify_keyword(const char* begin, const char* end) {
+  return keyword_hash.classify(begin, size_t(end - begin));
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,208 @@
+#include "parseroni/Lexer.h"
+
+#include "parseroni/Instrument.h"
+#include "parseroni/Keywords.h"
+#include "parseroni/Numbers.h"
+#include "parseroni/Punctuators.h"
+#include "parseroni/Scanners.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+const char* lex_type_name(LexType type) {
+  switch(type) {
+    case LEX_INVALID:      return "invalid";
+    case LEX_SPLICE:       return "splice";
+    case LEX_PREPROC:      return "preproc";
+    case LEX_RAW_STRING:   return "raw_string";
+    case LEX_FLOAT:        return "float";
+    case LEX_SPACE:        return "space";
+    case LEX_NEWLINE:      return "newline";
+    case LEX_STRING:       return "string";
+    case LEX_COMMENT1:     return "comment1";
+    case LEX_COMMENT2:     return "comment2";
+    case LEX_IDENTIFIER:   return "identifier";
+    case LEX_KEYWORD:      return "keyword";
+    case LEX_INT:          return "int";
+    case LEX_CHAR_LITERAL: return "char_literal";
+    case LEX_PUNCT:        return "punct";
+    default:               return "<bad type>";
+  }
+}
+
+//------------------------------------------------------------------------------
+// First-byte sets. These are deliberately generous - a rule listed for a byte
+// it can't actually start with just fails, same as in a plain if/else chain.
+
+#define LOWER  "abcdefghijklmnopqrstuvwxyz"
+#define UPPER  "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+#define DIGITS "0123456789"
+
+// Identifiers can also start with '$' (a common extension) or a UTF-8 lead byte.
+static constexpr char first_ident[] =
+  LOWER UPPER "_$"
+  "\x80\x81\x82\x83\x84\x85\x86\x87\x88\x89\x8A\x8B\x8C\x8D\x8E\x8F"
+  "\x90\x91\x92\x93\x94\x95\x96\x97\x98\x99\x9A\x9B\x9C\x9D\x9E\x9F"
+  "\xA0\xA1\xA2\xA3\xA4\xA5\xA6\xA7\xA8\xA9\xAA\xAB\xAC\xAD\xAE\xAF"
+  "\xB0\xB1\xB2\xB3\xB4\xB5\xB6\xB7\xB8\xB9\xBA\xBB\xBC\xBD\xBE\xBF"
+  "\xC0\xC1\xC2\xC3\xC4\xC5\xC6\xC7\xC8\xC9\xCA\xCB\xCC\xCD\xCE\xCF"
+  "\xD0\xD1\xD2\xD3\xD4\xD5\xD6\xD7\xD8\xD9\xDA\xDB\xDC\xDD\xDE\xDF"
+  "\xE0\xE1\xE2\xE3\xE4\xE5\xE6\xE7\xE8\xE9\xEA\xEB\xEC\xED\xEE\xEF"
+  "\xF0\xF1\xF2\xF3\xF4\xF5\xF6\xF7\xF8\xF9\xFA\xFB\xFC\xFD\xFE\xFF";
+
+static constexpr char first_number[]  = DIGITS ".";
+static constexpr char first_space[]   = " \t\v\f";
+static constexpr char first_newline[] = "\r\n";
+static constexpr char first_comment[] = "/";
+static constexpr char first_preproc[] = "#";
+static constexpr char first_punct[]   = "!#%&()*+,-./:;<=>?[]^{|}~";
+
+// Bytes no punctuator starts with. They still lex, one byte at a time, so
+// stray characters and unterminated quotes don't stop the lexer.
+static constexpr char first_stray[]   = "\"'@\\`";
+
+// String and character literals may carry an encoding prefix - u8"", u"", U"", L"".
+static constexpr char first_string[]  = "\"uUL";
+static constexpr char first_char[]    = "'uUL";
+static constexpr char first_raw[]     = "RuUL";
+
+//------------------------------------------------------------------------------
+
+static const char* scan_stray(const char* text) {
+  return text + 1;
+}
+
+static const char* lex_number(const char* text, LexType& type) {
+  NumberInfo info;
+  auto end = PROBE_CALL("scan_number", scan_number(text, info));
+  type = info.is_float ? LEX_FLOAT : LEX_INT;
+  return end;
+}
+
+// Every matcher goes through PROBE_MATCHER so -DPARSERONI_INSTRUMENT can show
+// which alternatives burn cycles failing. It's a no-op otherwise.
+
+static constexpr LexRule lex_rules[] = {
+  { LEX_PREPROC,      PROBE_MATCHER(match_preproc),           first_preproc },
+  { LEX_RAW_STRING,   PROBE_MATCHER(match_raw_string),        first_raw },
+  { LEX_INT,          nullptr,                                first_number, lex_number },
+  { LEX_SPACE,        PROBE_MATCHER(scan_space),              first_space },
+  { LEX_NEWLINE,      PROBE_MATCHER(match_newline),           first_newline },
+  { LEX_STRING,       PROBE_MATCHER(scan_string),             first_string },
+  { LEX_COMMENT1,     PROBE_MATCHER(match_oneline_comment),   first_comment },
+  { LEX_COMMENT2,     PROBE_MATCHER(scan_multiline_comment),  first_comment },
+  { LEX_CHAR_LITERAL, PROBE_MATCHER(scan_char_literal),       first_char },
+  { LEX_IDENTIFIER,   PROBE_MATCHER(scan_identifier),         first_ident },
+  { LEX_PUNCT,        PROBE_MATCHER(scan_punct),              first_punct },
+  { LEX_PUNCT,        PROBE_MATCHER(scan_stray),              first_stray },
+};
+
+// Literals come before identifiers in both tables so an encoding prefix
+// isn't taken as a name.
+static constexpr LexRule token_rules[] = {
+  { LEX_STRING,       PROBE_MATCHER(scan_string),             first_string },
+  { LEX_CHAR_LITERAL, PROBE_MATCHER(scan_char_literal),       first_char },
+  { LEX_IDENTIFIER,   PROBE_MATCHER(scan_identifier),         first_ident },
+  { LEX_INT,          nullptr,                                first_number, lex_number },
+  { LEX_PREPROC,      PROBE_MATCHER(match_preproc),           first_preproc },
+  { LEX_PUNCT,        PROBE_MATCHER(scan_punct),              first_punct },
+  { LEX_PUNCT,        PROBE_MATCHER(scan_stray),              first_stray },
+};
+
+constinit const DispatchTable lex_dispatch(lex_rules, sizeof(lex_rules) / sizeof(lex_rules[0]));
+constinit const DispatchTable token_dispatch(token_rules, sizeof(token_rules) / sizeof(token_rules[0]));
+
+//------------------------------------------------------------------------------
+
+const char* lex_next(const char* text, LexType& type) {
+  auto end = lex_dispatch.match(text, type);
+  if (type == LEX_IDENTIFIER && classify_keyword(text, end)) type = LEX_KEYWORD;
+  return end;
+}
+
+//------------------------------------------------------------------------------
+// These are exactly the cases where a rule that scans for a terminator comes
+// before a shorter rule for the same first byte in lex_rules.
+
+const char* lex_fallback_stop(const char* begin, const char* end, LexType type) {
+  auto len = end - begin;
+
+  if (type == LEX_PUNCT) {
+    if (len != 1) return nullptr;
+    if (begin[0] == '/' && (end[0] == '*' || end[0] == '/')) return end + strlen(end);
+
+    // A lone quote is what's left of a string or char literal that didn't
+    // close.
+    if (begin[0] == '"' || begin[0] == '\'') {
+      auto p = find_quote_end(end, begin[0]);
+      while (p[0] == '\\' && p[1]) p = find_quote_end(p + 2, begin[0]);
+      return p;
+    }
+    return nullptr;
+  }
+
+  if (type == LEX_IDENTIFIER && len <= 3 && (end[0] == '"' || end[0] == '\'')) {
+    // Encoding and raw prefixes - u8, u, U, L, R, u8R, uR, UR, LR.
+    auto p = begin;
+    if (p[0] == 'u' && p[1] == '8') p += 2;
+    else if (p[0] == 'u' || p[0] == 'U' || p[0] == 'L') p += 1;
+    if (p < end && *p == 'R' && end[0] == '"') p++;
+    if (p != end) return nullptr;
+
+    // A raw string looks for its '(' as far as it has to.
+    if (end[-1] == 'R') return end + strlen(end);
+
+    auto q = find_quote_end(end + 1, end[0]);
+    while (q[0] == '\\' && q[1]) q = find_quote_end(q + 2, end[0]);
+    return q;
+  }
+
+  return nullptr;
+}
+
+bool lex_is_fallback(const char* begin, const char* end, LexType type) {
+  auto stop = lex_fallback_stop(begin, end, type);
+  return stop && *stop == 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool lex_all(const char* text, size_t size, TokenBuffer& out) {
+  assert(size <= UINT32_MAX);
+  assert(text[size] == 0);
+
+  out.clear();
+  // Real code averages a bit over 4 bytes a token.
+  out.types.reserve(size / 4 + 16);
+  out.ends.reserve(size / 4 + 16);
+
+  return lex_range(text, 0, uint32_t(size), out) >= size;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t lex_range(const char* text, uint32_t begin, uint32_t stop, TokenBuffer& out) {
+  auto cursor = text + begin;
+  auto end = text + stop;
+
+  while (cursor < end) {
+    // Lines ending in a backslash and a newline (LF or CRLF) get spliced together with the following line
+    if (auto splice = match_splice(cursor)) {
+      cursor = splice;
+      out.push(LEX_SPLICE, uint32_t(cursor - text));
+      continue;
+    }
+
+    LexType type;
+    auto token_end = lex_next(cursor, type);
+    if (!token_end) break;
+
+    cursor = token_end;
+    out.push(type, uint32_t(cursor - text));
+  }
+
+  return uint32_t(cursor - text);
+}
+
+//------------------------------------------------------------------------------
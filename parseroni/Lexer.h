@@ -0,0 +1,169 @@
+#pragma once
+
+#include "parseroni/Combinators.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Token types produced by the lexer. Stored as a byte so that token streams
+// stay compact.
+
+enum LexType : uint8_t {
+  LEX_INVALID = 0,
+  LEX_SPLICE,
+  LEX_PREPROC,
+  LEX_RAW_STRING,
+  LEX_FLOAT,
+  LEX_SPACE,
+  LEX_NEWLINE,
+  LEX_STRING,
+  LEX_COMMENT1,
+  LEX_COMMENT2,
+  LEX_IDENTIFIER,
+  LEX_KEYWORD,
+  LEX_INT,
+  LEX_CHAR_LITERAL,
+  LEX_PUNCT,
+  LEX_TYPE_COUNT,
+};
+
+const char* lex_type_name(LexType type);
+
+using match_fn = const char* (*)(const char* text);
+
+// Matcher for rules that can produce more than one token type.
+using lex_fn = const char* (*)(const char* text, LexType& type);
+
+//------------------------------------------------------------------------------
+// A matcher plus the set of bytes it can start with. The first-byte set only
+// has to be a superset of what the matcher accepts - extra bytes just cost a
+// failed match attempt.
+//
+// If 'lex' is set it's used instead of 'match' and picks the type itself -
+// numbers are one rule that says int or float from a single scan.
+
+struct LexRule {
+  LexType     type;
+  match_fn    match;
+  const char* first;
+  lex_fn      lex = nullptr;
+};
+
+//------------------------------------------------------------------------------
+// 256-entry table keyed on the first byte of the input. Each entry holds the
+// (at most max_candidates) rules that can match starting with that byte, in
+// the order the rules were given, so the result is the same as trying every
+// rule in order but each failed rule costs a table lookup instead of a call.
+
+struct DispatchTable {
+  static const int max_candidates = 4;
+
+  constexpr DispatchTable(const LexRule* rules, int rule_count) : rules(rules), entries{} {
+    for (int i = 0; i < rule_count; i++) {
+      for (auto c = rules[i].first; *c; c++) {
+        auto& entry = entries[uint8_t(*c)];
+        assert(entry.count < max_candidates);
+        entry.rules[entry.count++] = uint8_t(i);
+      }
+    }
+  }
+
+  const char* match(const char* text, LexType& type) const {
+    auto& entry = entries[uint8_t(*text)];
+    for (int i = 0; i < entry.count; i++) {
+      auto& rule = rules[entry.rules[i]];
+      if (rule.lex) {
+        if (auto end = rule.lex(text, type)) return end;
+      }
+      else if (auto end = rule.match(text)) {
+        type = rule.type;
+        return end;
+      }
+    }
+    type = LEX_INVALID;
+    return nullptr;
+  }
+
+  struct Entry {
+    uint8_t count;
+    uint8_t rules[max_candidates];
+  };
+
+  const LexRule* rules;
+  Entry entries[256];
+};
+
+// Every token type, in the order test_scan has always tried them.
+extern const DispatchTable lex_dispatch;
+
+// The subset of tokens Parser::take_token() accepts (no whitespace/comments).
+extern const DispatchTable token_dispatch;
+
+// Lexes one token. Identifiers that are exactly a C keyword come back as
+// LEX_KEYWORD.
+const char* lex_next(const char* text, LexType& type);
+
+// A backslash-newline line splice, LF or CRLF.
+inline const char* match_splice(const char* text) {
+  if (text[0] != '\\') return nullptr;
+  if (text[1] == '\n') return text + 2;
+  if (text[1] == '\r' && text[2] == '\n') return text + 3;
+  return nullptr;
+}
+
+// True if [begin, end) only lexed as 'type' because a comment or literal that
+// starts at begin ran into the end of the text - the '/' of an unterminated
+// "/*", the 'L' of an unterminated L"...", the '"' of an unterminated "...".
+// With more text behind it the same spot could lex differently, which matters
+// when the text is a window into a stream.
+bool lex_is_fallback(const char* begin, const char* end, LexType type);
+
+// For a fallback, the byte the rule that lost gave up on - a newline or the
+// NUL at the end of the text. nullptr if [begin, end) isn't a fallback.
+const char* lex_fallback_stop(const char* begin, const char* end, LexType type);
+
+//------------------------------------------------------------------------------
+// Lexer output as a structure of arrays - one type byte and one end offset
+// per token, 5 bytes a token instead of a 16-byte cspan. Tokens are contiguous,
+// so token i covers [ends[i-1], ends[i]) with ends[-1] taken as 0.
+
+struct TokenBuffer {
+  void clear() {
+    types.clear();
+    ends.clear();
+  }
+
+  void push(LexType type, uint32_t end) {
+    types.push_back(type);
+    ends.push_back(end);
+  }
+
+  size_t size() const { return types.size(); }
+
+  uint32_t begin_of(size_t i) const { return i ? ends[i - 1] : 0; }
+  uint32_t end_of(size_t i)   const { return ends[i]; }
+
+  cspan span(const char* base, size_t i) const {
+    return cspan(base + begin_of(i), base + end_of(i));
+  }
+
+  std::vector<uint8_t>  types;
+  std::vector<uint32_t> ends;
+};
+
+// Lexes all of text[0, size) into out, replacing its contents. text[size]
+// must be zero. Returns false if some byte couldn't be lexed - the tokens up
+// to that point are left in out.
+bool lex_all(const char* text, size_t size, TokenBuffer& out);
+
+// Lexes from text + begin, appending to out, until a token ends at or past
+// 'stop'. Offsets are relative to text. Returns the offset lexing stopped at -
+// either >= stop, or the offset of the first byte that couldn't be lexed.
+//
+// The lexer has no state beyond the cursor, so two runs that both pass
+// through the same token boundary produce identical tokens from there on.
+uint32_t lex_range(const char* text, uint32_t begin, uint32_t stop, TokenBuffer& out);
+
+//------------------------------------------------------------------------------
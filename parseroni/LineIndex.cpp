@@ -0,0 +1,118 @@
+#include "parseroni/LineIndex.h"
+
+#include "parseroni/Simd.h"
+
+#include <algorithm>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+// Both loops below go scalar up to an alignment boundary, then a block at a
+// time, then scalar again for the tail, so they never read outside
+// [begin, end) and don't need a sentinel.
+
+size_t count_newlines(const char* begin, const char* end) {
+  size_t count = 0;
+  auto p = begin;
+
+#if PARSERONI_SIMD
+  while (p < end && (uintptr_t(p) & (vec_bytes - 1))) count += *p++ == '\n';
+
+  auto nl = vset('\n');
+  for (; end - p >= vec_bytes; p += vec_bytes) {
+    count += __builtin_popcount(vmask(veq(vload(p), nl)));
+  }
+#endif
+
+  while (p < end) count += *p++ == '\n';
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Lookups tend to go down the file, so each scan runs a good way past the
+// offset that triggered it.
+
+static const size_t scan_chunk = 64 * 1024;
+
+void LineIndex::scan_to(size_t offset) {
+  if (offset <= scanned) return;
+  assert(size <= UINT32_MAX);
+
+  auto target = std::min(size, std::max(offset, scanned + scan_chunk));
+  auto p = text + scanned;
+  auto end = text + target;
+
+  starts.reserve(starts.size() + count_newlines(p, end));
+
+  auto push = [&](const char* c) { starts.push_back(uint32_t(c + 1 - text)); };
+
+#if PARSERONI_SIMD
+  while (p < end && (uintptr_t(p) & (vec_bytes - 1))) {
+    if (*p == '\n') push(p);
+    p++;
+  }
+
+  auto nl = vset('\n');
+  for (; end - p >= vec_bytes; p += vec_bytes) {
+    for (auto hits = vmask(veq(vload(p), nl)); hits; hits &= hits - 1) {
+      push(p + __builtin_ctz(hits));
+    }
+  }
+#endif
+
+  for (; p < end; p++) {
+    if (*p == '\n') push(p);
+  }
+
+  scanned = target;
+}
+
+//------------------------------------------------------------------------------
+
+SourceLocation LineIndex::locate(size_t offset) {
+  if (offset > size) offset = size;
+  scan_to(offset);
+
+  // Diagnostics and dumps mostly walk forward through the file, often several
+  // per line, so try the line and column we finished on last time first.
+  auto on_line = [&](size_t line) {
+    return starts[line] <= offset && (line + 1 == starts.size() || offset < starts[line + 1]);
+  };
+
+  size_t line = last_line;
+  if (!on_line(line)) {
+    if (line + 1 < starts.size() && on_line(line + 1)) {
+      line++;
+    }
+    else {
+      line = std::upper_bound(starts.begin(), starts.end(), uint32_t(offset)) - starts.begin() - 1;
+    }
+  }
+
+  size_t begin = starts[line];
+  uint32_t col = 1;
+  if (line == last_line && offset >= last_offset) {
+    begin = last_offset;
+    col = last_col;
+  }
+
+  for (auto p = text + begin; p < text + offset; p++) {
+    if (*p == '\t') {
+      col = (col - 1) / tab_width * tab_width + tab_width + 1;
+    }
+    else if ((*p & 0xC0) != 0x80) {
+      col++;
+    }
+  }
+
+  last_line = line;
+  last_offset = offset;
+  last_col = col;
+
+  SourceLocation result;
+  result.line = uint32_t(line + 1);
+  result.col = col;
+  result.byte_col = uint32_t(offset - starts[line] + 1);
+  return result;
+}
+
+//------------------------------------------------------------------------------
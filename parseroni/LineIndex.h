@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Newlines in [begin, end), a vector compare and a popcount per block.
+
+size_t count_newlines(const char* begin, const char* end);
+
+//------------------------------------------------------------------------------
+// 1-based, like every compiler's diagnostics. 'col' is in display columns -
+// tabs go to the next tab stop and a UTF-8 sequence counts once - and
+// 'byte_col' is the plain byte count from the start of the line.
+
+struct SourceLocation {
+  uint32_t line = 0;
+  uint32_t col = 0;
+  uint32_t byte_col = 0;
+};
+
+//------------------------------------------------------------------------------
+// Offset -> line/column for one source buffer. Nothing is scanned until the
+// first lookup, and then only as far as the furthest offset asked for, so
+// reporting a location near the top of a huge file stays cheap. After that a
+// lookup is a binary search over the line starts plus a walk along one line.
+
+struct LineIndex {
+  void reset(const char* text, size_t size) {
+    this->text = text;
+    this->size = size;
+    scanned = 0;
+    starts.assign(1, 0);
+    last_line = 0;
+    last_offset = 0;
+    last_col = 1;
+  }
+
+  SourceLocation locate(size_t offset);
+
+  // Number of lines seen so far, which is all of them once something near
+  // the end has been looked up.
+  size_t line_count() const { return starts.size(); }
+
+  int tab_width = 8;
+
+  const char* text = nullptr;
+  size_t size = 0;
+  size_t scanned = 0;                // bytes indexed so far
+  std::vector<uint32_t> starts = {0};  // offset of the first byte of each line
+
+private:
+  void scan_to(size_t offset);
+
+  // Where the previous lookup ended up.
+  size_t   last_line = 0;
+  size_t   last_offset = 0;
+  uint32_t last_col = 1;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,66 @@
+#include "parseroni/MappedFile.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+
+bool MappedFile::open(const char* path) {
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t page = size_t(sysconf(_SC_PAGESIZE));
+  size_t file_size = size_t(st.st_size);
+  size_t padded = (file_size + 1 + page - 1) & ~(page - 1);
+
+  // Reserve the whole padded range as zero pages, then map the file over the
+  // front of it.
+  void* base = mmap(nullptr, padded, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+
+  if (file_size) {
+    void* file_map = mmap(base, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (file_map == MAP_FAILED) {
+      munmap(base, padded);
+      ::close(fd);
+      return false;
+    }
+    madvise(base, file_size, MADV_SEQUENTIAL);
+  }
+
+  // The mapping keeps its own reference to the file.
+  ::close(fd);
+
+  map_base = base;
+  map_size = padded;
+  data = (const char*)base;
+  size = file_size;
+  assert(data[size] == 0);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+void MappedFile::close() {
+  if (map_base) munmap(map_base, map_size);
+  map_base = nullptr;
+  map_size = 0;
+  data = nullptr;
+  size = 0;
+}
+
+//------------------------------------------------------------------------------
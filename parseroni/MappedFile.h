@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+// Read-only memory mapping of a file that is always followed by at least one
+// zero byte, so it can be handed straight to the matchers.
+//
+// The mapping is padded out to a page boundary past the end of the file. The
+// kernel zero-fills the tail of the last file page, and if the file is an
+// exact multiple of the page size we map an extra anonymous zero page behind
+// it.
+
+struct MappedFile {
+  MappedFile() {}
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const char* path);
+  void close();
+
+  const char* data = nullptr;
+  size_t size = 0;
+
+private:
+  void*  map_base = nullptr;
+  size_t map_size = 0;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,55 @@
+#include "parseroni/Memo.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+
+void MemoTable::store(int rule, uint32_t offset, MemoResult result) {
+  // Keep the load under 1/2 so probe runs stay short.
+  if ((count + 1) * 2 > entries.size()) grow();
+
+  auto key = make_key(rule, offset);
+  for (size_t i = slot(key);; i = (i + 1) & mask) {
+    auto& e = entries[i];
+    if (e.key == key) {
+      e.result = result;
+      return;
+    }
+    if (e.key == empty_key) {
+      e.key = key;
+      e.result = result;
+      count++;
+      return;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void MemoTable::clear() {
+  if (!count) return;
+  std::fill(entries.begin(), entries.end(), Entry{empty_key, {nullptr, nullptr}});
+  count = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void MemoTable::grow() {
+  std::vector<Entry> old;
+  old.swap(entries);
+
+  entries.assign(old.empty() ? 1024 : old.size() * 2, Entry{empty_key, {nullptr, nullptr}});
+  mask = entries.size() - 1;
+
+  for (auto& e : old) {
+    if (e.key == empty_key) continue;
+    for (size_t i = slot(e.key);; i = (i + 1) & mask) {
+      if (entries[i].key == empty_key) {
+        entries[i] = e;
+        break;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Packrat memo table - remembers what each grammar rule did at each offset, so
+// backtracking into a rule we've already tried is a lookup instead of a
+// reparse. Open addressing, linear probing, power-of-two capacity. Nothing is
+// allocated until the first store(), so a parser that never memoizes never
+// pays for the table.
+
+struct MemoResult {
+  const char* end;  // nullptr if the rule failed here
+  void*       node; // whatever node the rule built, if any
+};
+
+class MemoTable {
+public:
+
+  MemoTable() {}
+
+  bool lookup(int rule, uint32_t offset, MemoResult& out) {
+    if (!count) {
+      misses++;
+      return false;
+    }
+
+    auto key = make_key(rule, offset);
+    for (size_t i = slot(key);; i = (i + 1) & mask) {
+      auto& e = entries[i];
+      if (e.key == key) {
+        out = e.result;
+        hits++;
+        return true;
+      }
+      if (e.key == empty_key) {
+        misses++;
+        return false;
+      }
+    }
+  }
+
+  void store(int rule, uint32_t offset, MemoResult result);
+
+  // Empties the table but keeps its capacity. Doesn't touch the stats.
+  void clear();
+
+  void clear_stats() {
+    hits = 0;
+    misses = 0;
+  }
+
+  size_t size() const { return count; }
+
+  size_t hits = 0;
+  size_t misses = 0;
+
+private:
+
+  static const uint64_t empty_key = ~uint64_t(0);
+
+  struct Entry {
+    uint64_t   key;
+    MemoResult result;
+  };
+
+  static uint64_t make_key(int rule, uint32_t offset) {
+    return (uint64_t(offset) << 16) | uint64_t(uint16_t(rule));
+  }
+
+  size_t slot(uint64_t key) const {
+    return size_t((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+  }
+
+  void grow();
+
+  std::vector<Entry> entries;
+  size_t mask = 0;
+  size_t count = 0;
+};
+
+//------------------------------------------------------------------------------
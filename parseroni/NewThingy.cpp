@@ -1,37 +1,16 @@
 #include <stdio.h>
 
 #include <string.h>
-#include <filesystem>
 #include <regex>
 
 #include "metrolib/core/Tests.h"
 #include "parseroni/Combinators.h"
+#include "parseroni/Lexer.h"
+#include "parseroni/CorpusScan.h"
+#include "parseroni/Instrument.h"
 
 using namespace matcheroni;
 
-using rdit = std::filesystem::recursive_directory_iterator;
-
-enum SourceTag {
-  // Lexical elements
-  KEYWORD,
-  IDENTIFIER,
-  CONSTANT,
-  STRING,
-  PUNCTUATOR,
-  PREPROC,
-
-  // Delimited blocks
-  BLOCK_CURLY,
-  BLOCK_SQUARE,
-  BLOCK_ANGLE,
-  BLOCK_PAREN,
-};
-
-struct SourceMark {
-  SourceTag tag;
-  int end;
-};
-
 void log_span(const char* start, const char* end, uint32_t color = 0) {
   auto& log = TinyLog::get();
 
@@ -63,102 +42,19 @@ void log_span(const char* start, const char* end, uint32_t color = 0) {
   */
 }
 
-int hit_char_literal = 0;
-int hit_comment1 = 0;
-int hit_comment2 = 0;
-int hit_float = 0;
-int hit_identifier = 0;
-int hit_int = 0;
-int hit_newline = 0;
-int hit_preproc = 0;
-int hit_punct = 0;
-int hit_raw_string = 0;
-int hit_space = 0;
-int hit_splice = 0;
-int hit_string = 0;
-
 //------------------------------------------------------------------------------
 
-TestResults test_scan(const std::string path, size_t size) {
+TestResults test_scan(const std::string& path) {
   TestResults results;
 
-  std::string text;
-  text.resize(size);
-  FILE* f = fopen(path.c_str(), "rb");
-  auto r = fread(text.data(), 1, size, f);
-  fclose(f);
+  TokenBuffer tokens;
+  FileResult file;
+  bool ok = lex_file(path.c_str(), tokens, file);
 
-  const char* cursor = text.data();
-
-  while(*cursor) {
-    /*
-    if (auto end = Lit<"\n\r">::match(cursor)) {
-      printf("weird newline\n");
-      cursor = end;
-    }
-    else
-    */
-
-    //log_span(cursor, end);
-
-    // Lines ending in a backslash and a newline get spliced together with the following line
-    if (auto end = Lit<"\\\n">::match(cursor)) {
-      hit_splice++;
-      cursor = end;
-    }
-    if (auto end = match_preproc(cursor)) {
-      hit_preproc++;
-      cursor = end;
-    }
-    else if (auto end = match_raw_string(cursor)) {
-      hit_raw_string++;
-      cursor = end;
-    }
-    else if (auto end = match_float(cursor)) {
-      hit_float++;
-      cursor = end;
-    }
-    else if (auto end = match_space(cursor)) {
-      hit_space++;
-      cursor = end;
-    }
-    else if (auto end = match_newline(cursor)) {
-      hit_newline++;
-      cursor = end;
-    }
-    else if (auto end = match_string(cursor)) {
-      hit_string++;
-      cursor = end;
-    }
-    else if (auto end = match_oneline_comment(cursor)) {
-      hit_comment1++;
-      cursor = end;
-    }
-    else if (auto end = match_multiline_comment(cursor)) {
-      hit_comment2++;
-      cursor = end;
-    }
-    else if (auto end = match_identifier(cursor)) {
-      hit_identifier++;
-      cursor = end;
-    }
-    else if (auto end = match_int(cursor)) {
-      hit_int++;
-      cursor = end;
-    }
-    else if (auto end = match_char_literal(cursor)) {
-      hit_char_literal++;
-      cursor = end;
-    }
-    else if (auto end = match_punct(cursor)) {
-      hit_punct++;
-      cursor = end;
-    }
-    else {
-      //LOG_R("File %s:\nCould not match {%.40s}\n\n", path.c_str(), cursor);
-      results.test_fail++;
-      return results;
-    }
+  if (!ok) {
+    //LOG_R("File %s:\nCould not match at offset %d\n\n", path.c_str(), file.error_offset);
+    results.test_fail++;
+    return results;
   }
 
   results.test_pass++;
@@ -167,26 +63,14 @@ TestResults test_scan(const std::string path, size_t size) {
 
 //------------------------------------------------------------------------------
 
-int total_files = 0;
-int total_bytes = 0;
-int source_files = 0;
-
-TestResults test_dir(const char* base_path) {
+TestResults test_dir(const char* base_path, CorpusStats& totals) {
   TestResults results;
-  for (const auto& f : rdit(base_path)) {
-    //printf("path %s\n", f.path().c_str());
-    //printf("size %d\n", f.file_size());
-    if (f.is_regular_file()) {
-      total_files++;
-      auto& path = f.path().native();
-      auto size = f.file_size();
-      if (path.ends_with(".h") || path.ends_with(".cpp") || path.ends_with(".c")) {
-        source_files++;
-        results << test_scan(path, size);
-        total_bytes += size;
-      }
-    }
-  }
+
+  auto stats = scan_corpus({base_path});
+  totals.merge(stats);
+
+  results.test_pass += int(stats.source_files - stats.failed_files);
+  results.test_fail += int(stats.failed_files);
   return results;
 }
 
@@ -209,28 +93,21 @@ TestResults test_thingy() {
   benchmark();
 
 #if 0
-  results << test_dir("../MetroLib");
-  results << test_dir("../Metron");
-  results << test_dir(".");
-  results << test_dir("../gcc/gcc");
-
-  printf("total files %d\n", total_files);
-  printf("source files %d\n", source_files);
-  printf("total bytes %d\n", total_bytes);
-
-  printf("hit_char_literal %d\n", hit_char_literal);
-  printf("hit_comment1     %d\n", hit_comment1    );
-  printf("hit_comment2     %d\n", hit_comment2    );
-  printf("hit_float        %d\n", hit_float       );
-  printf("hit_identifier   %d\n", hit_identifier  );
-  printf("hit_int          %d\n", hit_int         );
-  printf("hit_newline      %d\n", hit_newline     );
-  printf("hit_preproc      %d\n", hit_preproc     );
-  printf("hit_punct        %d\n", hit_punct       );
-  printf("hit_raw_string   %d\n", hit_raw_string  );
-  printf("hit_space        %d\n", hit_space       );
-  printf("hit_splice       %d\n", hit_splice      );
-  printf("hit_string       %d\n", hit_string      );
+  CorpusStats totals;
+  results << test_dir("../MetroLib", totals);
+  results << test_dir("../Metron", totals);
+  results << test_dir(".", totals);
+  results << test_dir("../gcc/gcc", totals);
+
+  printf("total files %zu\n", totals.total_files);
+  printf("source files %zu\n", totals.source_files);
+  printf("total bytes %zu\n", totals.total_bytes);
+
+  for (int i = LEX_SPLICE; i < LEX_TYPE_COUNT; i++) {
+    printf("hit_%-16s %lu\n", lex_type_name(LexType(i)), totals.hit_counts[i]);
+  }
+
+  instrument_report();
 #endif
 
   TEST_DONE();
@@ -0,0 +1,629 @@
+#include "parseroni/Numbers.h"
+
+#include <charconv>
+#include <stddef.h>
+#include <string.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "SWAR digit decoding assumes little-endian loads");
+
+//------------------------------------------------------------------------------
+// Digit value of every byte, 0xFF for anything that isn't [0-9a-fA-F].
+
+struct DigitTable {
+  constexpr DigitTable() : value{} {
+    for (int i = 0; i < 256; i++) value[i] = 0xFF;
+    for (int i = 0; i < 10; i++) value['0' + i] = uint8_t(i);
+    for (int i = 0; i < 6; i++) {
+      value['a' + i] = uint8_t(10 + i);
+      value['A' + i] = uint8_t(10 + i);
+    }
+  }
+  uint8_t value[256];
+};
+
+static constexpr DigitTable digit_table;
+
+inline bool is_digit(char c, int base = 10) {
+  return digit_table.value[uint8_t(c)] < base;
+}
+
+inline bool is_ident(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+//------------------------------------------------------------------------------
+// Eight digits packed in a uint64_t, first digit in the low byte.
+
+__attribute__((no_sanitize_address))
+inline uint64_t load8(const char* p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+// An 8-byte load at p stays inside p's page, so it can't fault even if the
+// terminator is only a byte or two away.
+inline bool load8_in_page(const char* p) {
+  return (uintptr_t(p) & 4095) <= 4096 - 8;
+}
+
+// High bit set in every byte that isn't '0'-'9'. After the xor a digit byte is
+// 0-9, and adding 0x76 to the low seven bits carries into bit 7 for 10 and up.
+inline uint64_t swar_nondigits(uint64_t v) {
+  uint64_t x = v ^ 0x3030303030303030ull;
+  return (((x & 0x7F7F7F7F7F7F7F7Full) + 0x7676767676767676ull) | x) & 0x8080808080808080ull;
+}
+
+// Each step merges neighbouring lanes, the earlier (lower) lane being the more
+// significant digit.
+
+inline uint32_t swar_decode_dec(uint64_t v) {
+  v -= 0x3030303030303030ull;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+       (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+  return uint32_t(v);
+}
+
+inline uint32_t swar_decode_hex(uint64_t v) {
+  // Letters have bit 6 set, and 'a' & 15 == 1, so letter = low nibble + 9.
+  v = (v & 0x0F0F0F0F0F0F0F0Full) + ((v & 0x4040404040404040ull) >> 6) * 9;
+  v = ((v & 0x000F000F000F000Full) << 4)  | ((v & 0x0F000F000F000F00ull) >> 8);
+  v = ((v & 0x000000FF000000FFull) << 8)  | ((v & 0x00FF000000FF0000ull) >> 16);
+  v = ((v & 0x000000000000FFFFull) << 16) | ((v & 0x0000FFFF00000000ull) >> 32);
+  return uint32_t(v);
+}
+
+inline uint32_t swar_decode_oct(uint64_t v) {
+  v -= 0x3030303030303030ull;
+  v = ((v & 0x0007000700070007ull) << 3)  | ((v & 0x0700070007000700ull) >> 8);
+  v = ((v & 0x0000003F0000003Full) << 6)  | ((v & 0x003F0000003F0000ull) >> 16);
+  v = ((v & 0x0000000000000FFFull) << 12) | ((v & 0x00000FFF00000000ull) >> 32);
+  return uint32_t(v);
+}
+
+inline uint32_t swar_decode_bin(uint64_t v) {
+  // The multiply moves bit 0 of byte i to bit 63 - i, with no carries.
+  return uint32_t(((v & 0x0101010101010101ull) * 0x8040201008040201ull) >> 56);
+}
+
+//------------------------------------------------------------------------------
+
+const char* skip_digits(const char* text, int base) {
+  if (base == 10) {
+    while (load8_in_page(text)) {
+      if (auto miss = swar_nondigits(load8(text))) {
+        return text + (__builtin_ctzll(miss) >> 3);
+      }
+      text += 8;
+    }
+  }
+  while (is_digit(*text, base)) text++;
+  return text;
+}
+
+//------------------------------------------------------------------------------
+
+bool decode_digits(const char* begin, const char* end, int base, uint64_t& out) {
+  uint64_t accum = 0;
+
+  if (base == 10) {
+    for (; end - begin >= 8; begin += 8) {
+      if (__builtin_mul_overflow(accum, 100000000ull, &accum)) return false;
+      if (__builtin_add_overflow(accum, swar_decode_dec(load8(begin)), &accum)) return false;
+    }
+    for (; begin < end; begin++) {
+      if (__builtin_mul_overflow(accum, 10ull, &accum)) return false;
+      if (__builtin_add_overflow(accum, uint64_t(*begin - '0'), &accum)) return false;
+    }
+    out = accum;
+    return true;
+  }
+
+  // Power-of-two bases overflow exactly when a set bit would get shifted out.
+  // Leading zeros can't do that, however many there are.
+  int bits = base == 16 ? 4 : base == 8 ? 3 : 1;
+  while (begin < end && *begin == '0') begin++;
+
+  for (; end - begin >= 8; begin += 8) {
+    if (accum >> (64 - 8 * bits)) return false;
+    auto v = load8(begin);
+    uint32_t chunk = base == 16 ? swar_decode_hex(v) : base == 8 ? swar_decode_oct(v) : swar_decode_bin(v);
+    accum = (accum << (8 * bits)) | chunk;
+  }
+  for (; begin < end; begin++) {
+    if (accum >> (64 - bits)) return false;
+    accum = (accum << bits) | digit_table.value[uint8_t(*begin)];
+  }
+
+  out = accum;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool is_int_suffix(const char* s, const char* end, NumberInfo& info) {
+  if (s < end && (*s | 0x20) == 'u') {
+    info.is_unsigned = true;
+    s++;
+  }
+  // l, L, ll or LL - but not lL.
+  if (s < end && (*s == 'l' || *s == 'L')) {
+    info.longs = (s + 1 < end && s[1] == s[0]) ? 2 : 1;
+    s += info.longs;
+  }
+  if (!info.is_unsigned && s < end && (*s | 0x20) == 'u') {
+    info.is_unsigned = true;
+    s++;
+  }
+  return s == end;
+}
+
+static bool is_float_suffix(const char* s, const char* end, NumberInfo& info) {
+  if (s == end) return true;
+  if (end - s != 1) return false;
+  if ((*s | 0x20) == 'l') info.longs = 1;
+  if ((*s | 0x20) == 'f') info.is_single = true;
+  return (*s | 0x20) == 'f' || (*s | 0x20) == 'l';
+}
+
+//------------------------------------------------------------------------------
+
+const char* scan_number(const char* text, NumberInfo& info) {
+  info = NumberInfo();
+
+  auto p = text;
+  if (!is_digit(p[0]) && !(p[0] == '.' && is_digit(p[1]))) return nullptr;
+
+  if (p[0] == '0' && (p[1] | 0x20) == 'x' && (is_digit(p[2], 16) || (p[2] == '.' && is_digit(p[3], 16)))) {
+    info.base = 16;
+    p += 2;
+  }
+  else if (p[0] == '0' && (p[1] | 0x20) == 'b' && is_digit(p[2], 2)) {
+    info.base = 2;
+    p += 2;
+  }
+
+  info.digits = p;
+  p = skip_digits(p, info.base);
+  info.digits_end = p;
+
+  if (*p == '.') {
+    info.is_float = true;
+    p = skip_digits(p + 1, info.base == 16 ? 16 : 10);
+  }
+
+  // Decimal exponents are e, hex ones are p. An 'e' with no digits after it is
+  // left for the suffix check to reject.
+  bool has_exponent = false;
+  if ((*p | 0x20) == (info.base == 16 ? 'p' : 'e')) {
+    auto e = p + 1;
+    if (*e == '+' || *e == '-') e++;
+    if (is_digit(*e)) {
+      info.is_float = true;
+      has_exponent = true;
+      p = skip_digits(e, 10);
+    }
+  }
+
+  bool ok = true;
+  if (info.is_float) {
+    if (info.base == 2) ok = false;
+    if (info.base == 16 && !has_exponent) ok = false;
+  }
+  else if (info.base == 10 && info.digits[0] == '0') {
+    info.base = 8;
+    ok = skip_digits(info.digits, 8) == info.digits_end;
+  }
+
+  // Whatever is left of the pp-number is the suffix. That includes a sign right
+  // after an e or p, so "0x1e+1" is one (bad) number, same as in the standard.
+  info.suffix = p;
+  auto end = p;
+  while (1) {
+    if (is_ident(*end) || *end == '.') {
+      end++;
+    }
+    else if ((*end == '+' || *end == '-') && ((end[-1] | 0x20) == 'e' || (end[-1] | 0x20) == 'p')) {
+      end++;
+    }
+    else {
+      break;
+    }
+  }
+
+  if (info.is_float) {
+    ok = is_float_suffix(info.suffix, end, info) && ok;
+  }
+  else {
+    ok = is_int_suffix(info.suffix, end, info) && ok;
+  }
+
+  info.valid = ok;
+  return end;
+}
+
+const char* scan_number(const char* text) {
+  NumberInfo info;
+  return scan_number(text, info);
+}
+
+//------------------------------------------------------------------------------
+// Float values.
+//
+// Eisel-Lemire needs the top 128 bits of 5^q for q in [-342, 308], truncated
+// for q >= 0 and rounded up for q < 0 - the same table fast_float uses, built
+// here at compile time. 5^q is just repeated multiplication. For q < 0 we need
+// floor(2^b / 5^-q) for various b, which is floor(2^B / 5^-q) >> (B - b) for
+// any big enough B, and floor(2^B / 5^k) is k successive divisions by 5.
+
+struct PowersOfFive {
+  static const int min_q = -342;
+  static const int max_q = 308;
+  static const int count = max_q - min_q + 1;
+
+  // Little-endian 32-bit words. 2^B needs B + 1 bits, B has to cover the
+  // largest b below (about 1720 for 5^342).
+  static const int big_bits = 1760;
+  static const int big_words = big_bits / 32 + 1;
+
+  struct Big {
+    uint32_t w[big_words];
+
+    constexpr uint32_t word(int i) const {
+      return (i < 0 || i >= big_words) ? 0 : w[i];
+    }
+
+    constexpr int bit_length() const {
+      for (int i = big_words - 1; i >= 0; i--) {
+        if (w[i]) return i * 32 + 32 - __builtin_clz(w[i]);
+      }
+      return 0;
+    }
+
+    // 32 or 64 bits starting at bit 'pos', which can be negative.
+    constexpr uint32_t bits32(int pos) const {
+      uint64_t pair = (uint64_t(word((pos >> 5) + 1)) << 32) | word(pos >> 5);
+      return uint32_t(pair >> (pos & 31));
+    }
+
+    constexpr uint64_t bits64(int pos) const {
+      return bits32(pos) | (uint64_t(bits32(pos + 32)) << 32);
+    }
+
+    constexpr void mul5() {
+      uint64_t carry = 0;
+      for (auto& x : w) {
+        carry += uint64_t(x) * 5;
+        x = uint32_t(carry);
+        carry >>= 32;
+      }
+    }
+
+    constexpr void div5() {
+      uint64_t rem = 0;
+      for (int i = big_words - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | w[i];
+        w[i] = uint32_t(cur / 5);
+        rem = cur % 5;
+      }
+    }
+  };
+
+  // Top 128 bits of x, shifted up if x is shorter than that.
+  constexpr void store(int q, const Big& x) {
+    int shift = x.bit_length() - 128;
+    table[2 * (q - min_q)]     = x.bits64(shift + 64);
+    table[2 * (q - min_q) + 1] = x.bits64(shift);
+  }
+
+  constexpr PowersOfFive() : table{} {
+    Big pow5 = {};
+    pow5.w[0] = 1;
+    for (int q = 0; q <= max_q; q++) {
+      store(q, pow5);
+      pow5.mul5();
+    }
+
+    pow5 = {};
+    pow5.w[0] = 1;
+    Big recip = {};
+    recip.w[big_bits / 32] = 1u << (big_bits % 32);
+
+    for (int k = 1; k <= -min_q; k++) {
+      pow5.mul5();
+      recip.div5();
+
+      // 2^z >= 5^k, and 5^k is never a power of two.
+      int z = pow5.bit_length();
+      int b = k <= 27 ? z + 127 : 2 * z + 128;
+
+      // floor(2^b / 5^k) + 1, which store() then truncates to 128 bits.
+      Big c = {};
+      for (int i = 0; i < big_words; i++) c.w[i] = recip.bits32(big_bits - b + 32 * i);
+      for (int i = 0; i < big_words && ++c.w[i] == 0; i++) {}
+
+      store(-k, c);
+    }
+  }
+
+  uint64_t table[2 * count];
+};
+
+static constexpr PowersOfFive powers_of_five;
+
+//------------------------------------------------------------------------------
+// Double bit patterns. Mantissas here include the hidden bit, so adding the
+// mantissa to (biased exponent - 1) << 52 sets the exponent and lets a rounding
+// carry roll over into it.
+
+static const int      mantissa_bits = 52;
+static const int      min_exponent = -1023;
+static const uint64_t infinity_bits = 0x7FF0000000000000ull;
+
+inline double bits_to_double(uint64_t bits) {
+  double d;
+  memcpy(&d, &bits, 8);
+  return d;
+}
+
+inline double make_double(uint64_t mantissa, int biased_exponent) {
+  uint64_t bits = biased_exponent ? (uint64_t(biased_exponent - 1) << mantissa_bits) + mantissa : mantissa;
+  return bits_to_double(bits >= infinity_bits ? infinity_bits : bits);
+}
+
+//------------------------------------------------------------------------------
+// Eisel-Lemire: the double nearest w * 10^q, w != 0, as a mantissa and biased
+// exponent. With w exact the 128-bit product is always enough to round
+// correctly (Mushtak & Lemire, "Fast Number Parsing Without Fallback").
+
+struct Binary {
+  uint64_t mantissa;
+  int      exponent;
+
+  bool operator == (const Binary& b) const {
+    return mantissa == b.mantissa && exponent == b.exponent;
+  }
+};
+
+static const Binary infinity = { 1ull << mantissa_bits, 0x7FF };
+
+static Binary eisel_lemire(int64_t q, uint64_t w) {
+  if (q < PowersOfFive::min_q) return { 0, 0 };
+  if (q > PowersOfFive::max_q) return infinity;
+
+  int lz = __builtin_clzll(w);
+  w <<= lz;
+
+  // Only the top 55 bits of the product matter. If the bits just below those
+  // are all ones, the low half of the power can still carry into them.
+  auto pow5 = &powers_of_five.table[2 * (q - PowersOfFive::min_q)];
+  auto first = (unsigned __int128)w * pow5[0];
+  uint64_t hi = uint64_t(first >> 64);
+  uint64_t lo = uint64_t(first);
+
+  const uint64_t precision_mask = ~0ull >> (mantissa_bits + 3);
+  if ((hi & precision_mask) == precision_mask) {
+    uint64_t second_hi = uint64_t(((unsigned __int128)w * pow5[1]) >> 64);
+    lo += second_hi;
+    if (second_hi > lo) hi++;
+  }
+
+  int upper_bit = int(hi >> 63);
+  int shift = upper_bit + 64 - mantissa_bits - 3;
+
+  Binary r;
+  r.mantissa = hi >> shift;
+  // floor(log2(10^q)) + 63, good over the whole table range.
+  int power = int(((152170 + 65536) * q) >> 16) + 63;
+  r.exponent = power + upper_bit - lz - min_exponent;
+
+  if (r.exponent <= 0) {
+    // Subnormal, or rounds to zero.
+    if (-r.exponent + 1 >= 64) return { 0, 0 };
+    r.mantissa >>= -r.exponent + 1;
+    r.mantissa += r.mantissa & 1;
+    r.mantissa >>= 1;
+    r.exponent = r.mantissa < (1ull << mantissa_bits) ? 0 : 1;
+    return r;
+  }
+
+  // An exact halfway case can only happen for small q, and shows up as a
+  // product with nothing below the kept bits - round to even there.
+  if (lo <= 1 && q >= -4 && q <= 23 && (r.mantissa & 3) == 1) {
+    if ((r.mantissa << shift) == hi) r.mantissa &= ~1ull;
+  }
+
+  r.mantissa += r.mantissa & 1;
+  r.mantissa >>= 1;
+  if (r.mantissa >= (2ull << mantissa_bits)) {
+    r.mantissa = 1ull << mantissa_bits;
+    r.exponent++;
+  }
+
+  if (r.exponent >= 0x7FF) return infinity;
+  return r;
+}
+
+//------------------------------------------------------------------------------
+
+static bool decode_decimal_float(const NumberInfo& info, double& out) {
+  static const double exact_powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  // Up to 19 significant digits go in w, the rest only move the exponent or
+  // mark the mantissa as truncated.
+  uint64_t w = 0;
+  int64_t  q = 0;
+  int  count = 0;
+  bool truncated = false;
+  bool in_fraction = false;
+
+  auto p = info.digits;
+  auto end = info.suffix;
+
+  for (; p < end; p++) {
+    if (*p == '.') {
+      in_fraction = true;
+      continue;
+    }
+    if (!is_digit(*p)) break;
+
+    if (count && count + 8 <= 19 && end - p >= 8 && !swar_nondigits(load8(p))) {
+      w = w * 100000000 + swar_decode_dec(load8(p));
+      count += 8;
+      if (in_fraction) q -= 8;
+      p += 7;
+      continue;
+    }
+
+    int d = *p - '0';
+    if (!count && !d) {
+      if (in_fraction) q--;
+    }
+    else if (count < 19) {
+      w = w * 10 + d;
+      count++;
+      if (in_fraction) q--;
+    }
+    else {
+      if (d) truncated = true;
+      if (!in_fraction) q++;
+    }
+  }
+
+  if (p < end && (*p | 0x20) == 'e') {
+    p++;
+    bool negative = *p == '-';
+    if (*p == '+' || *p == '-') p++;
+    int64_t e = 0;
+    for (; p < end && is_digit(*p); p++) {
+      if (e < 100000) e = e * 10 + (*p - '0');
+    }
+    q += negative ? -e : e;
+  }
+
+  if (!w) {
+    out = 0;
+    return true;
+  }
+
+  // Clinger - both operands exact, so one IEEE operation rounds correctly.
+  if (!truncated && q >= -22 && q <= 22 && w <= (1ull << 53)) {
+    out = q < 0 ? double(w) / exact_powers[-q] : double(w) * exact_powers[q];
+    return true;
+  }
+
+  auto r = eisel_lemire(q, w);
+
+  // The real mantissa is somewhere in [w, w + 1). If both ends round the same
+  // way, so does everything in between.
+  if (!truncated || r == eisel_lemire(q, w + 1)) {
+    out = make_double(r.mantissa, r.exponent);
+    return true;
+  }
+
+  auto result = std::from_chars(info.digits, info.suffix, out, std::chars_format::general);
+  if (result.ec == std::errc::result_out_of_range) {
+    out = q < 0 ? 0.0 : bits_to_double(infinity_bits);
+  }
+  return result.ec == std::errc() || result.ec == std::errc::result_out_of_range;
+}
+
+//------------------------------------------------------------------------------
+// Hex floats are exact binary, so all we have to do is round. The first 16
+// significant hex digits fill a uint64_t, anything after that only matters as
+// a sticky bit.
+
+static bool decode_hex_float(const NumberInfo& info, double& out) {
+  uint64_t m = 0;
+  int64_t  e2 = 0;
+  int  count = 0;
+  bool sticky = false;
+  bool in_fraction = false;
+
+  auto p = info.digits;
+  auto end = info.suffix;
+
+  for (; p < end; p++) {
+    if (*p == '.') {
+      in_fraction = true;
+      continue;
+    }
+    if (!is_digit(*p, 16)) break;
+
+    int d = digit_table.value[uint8_t(*p)];
+    if (!count && !d) {
+      if (in_fraction) e2 -= 4;
+    }
+    else if (count < 16) {
+      m = (m << 4) | d;
+      count++;
+      if (in_fraction) e2 -= 4;
+    }
+    else {
+      if (d) sticky = true;
+      if (!in_fraction) e2 += 4;
+    }
+  }
+
+  if (p >= end || (*p | 0x20) != 'p') return false;
+  p++;
+  bool negative = *p == '-';
+  if (*p == '+' || *p == '-') p++;
+  int64_t e = 0;
+  for (; p < end && is_digit(*p); p++) {
+    if (e < 100000) e = e * 10 + (*p - '0');
+  }
+  e2 += negative ? -e : e;
+
+  if (!m) {
+    out = 0;
+    return true;
+  }
+
+  // Normalize to m in [2^63, 2^64), value = 1.xxx * 2^exponent.
+  int lz = __builtin_clzll(m);
+  m <<= lz;
+  int64_t exponent = e2 - lz + 63;
+
+  if (exponent > 1023) {
+    out = bits_to_double(infinity_bits);
+    return true;
+  }
+
+  // Keep 53 bits for normals, fewer for subnormals.
+  int64_t shift = 63 - mantissa_bits;
+  int biased = 0;
+  if (exponent < min_exponent + 1) {
+    shift += (min_exponent + 1) - exponent;
+  }
+  else {
+    biased = int(exponent - min_exponent);
+  }
+
+  if (shift > 64) {
+    out = 0;
+    return true;
+  }
+
+  uint64_t mantissa = shift == 64 ? 0 : m >> shift;
+  uint64_t rest     = shift == 64 ? m : m << (64 - shift);
+  bool half  = rest >> 63;
+  bool above = (rest << 1) || sticky;
+  if (half && (above || (mantissa & 1))) mantissa++;
+
+  out = make_double(mantissa, biased);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool decode_float(const NumberInfo& info, double& out) {
+  if (!info.valid || !info.is_float) return false;
+  return info.base == 16 ? decode_hex_float(info, out) : decode_decimal_float(info, out);
+}
+
+//------------------------------------------------------------------------------
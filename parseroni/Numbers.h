@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// Numeric literals. scan_number() takes a whole pp-number in one pass and says
+// what it is - base, int or float, and the suffix - so the lexer doesn't have
+// to try an int matcher and a float matcher over the same digits.
+//
+// Like the preprocessor, scan_number() always takes the maximal pp-number, so
+// "09", "1.2.3" and "10ms" are each one token. Whether the token is a
+// well-formed C literal is reported in 'valid'.
+
+struct NumberInfo {
+  const char* digits = nullptr;     // integer digits, past any 0x/0b prefix
+  const char* digits_end = nullptr;
+  const char* suffix = nullptr;     // u/l/ll for ints, f/l for floats
+  uint8_t base = 10;                // 2, 8, 10 or 16
+  uint8_t longs = 0;                // 1 for l, 2 for ll
+  bool is_float = false;
+  bool is_single = false;           // f suffix
+  bool is_unsigned = false;
+  bool valid = false;
+};
+
+// End of the pp-number at text, or nullptr if there isn't one. Signs are not
+// part of a number - "-1" is a punctuator and then a number.
+const char* scan_number(const char* text, NumberInfo& info);
+const char* scan_number(const char* text);
+
+// Decodes [begin, end) as digits of the given base, eight at a time. The digits
+// must already be valid for the base (scan_number checks). Returns false if
+// the value doesn't fit in 64 bits.
+bool decode_digits(const char* begin, const char* end, int base, uint64_t& out);
+
+// The double nearest a float literal that scan_number() accepted, read
+// straight from the text - no copy, no strtod. Decimal literals go through
+// Clinger's exact fast path or Eisel-Lemire, with std::from_chars as the
+// fallback for the rare long mantissas Eisel-Lemire can't settle. Hex
+// literals are exact. Returns false if info isn't a valid float literal.
+bool decode_float(const NumberInfo& info, double& out);
+
+// End of the run of digits of the given base starting at text.
+const char* skip_digits(const char* text, int base);
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "parseroni/Punctuators.h"
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// C's binary, assignment and conditional operators, indexed by punctuator id,
+// for the precedence-climbing loop in Parser::take_expression(). The fifteen
+// or so levels of the C grammar collapse into one number per operator -
+// higher binds tighter - so an operand costs one table lookup instead of a
+// call per level.
+
+enum Precedence : uint8_t {
+  PREC_NONE = 0,
+  PREC_COMMA,
+  PREC_ASSIGN,
+  PREC_CONDITIONAL,
+  PREC_LOGICAL_OR,
+  PREC_LOGICAL_AND,
+  PREC_BIT_OR,
+  PREC_BIT_XOR,
+  PREC_BIT_AND,
+  PREC_EQUALITY,
+  PREC_RELATIONAL,
+  PREC_SHIFT,
+  PREC_ADDITIVE,
+  PREC_MULTIPLICATIVE,
+};
+
+enum OperatorKind : uint8_t {
+  OP_NONE = 0,
+  OP_BINARY,       // left-associative, builds a PBinaryExpression
+  OP_ASSIGN,       // right-associative, builds a PAssignmentExpression
+  OP_CONDITIONAL,  // "?", right-associative, takes a ':' and a third operand
+};
+
+struct OperatorInfo {
+  uint8_t prec = PREC_NONE;
+  uint8_t kind = OP_NONE;
+};
+
+//------------------------------------------------------------------------------
+// Prefix operators live in their own column - '*', '&', '+' and '-' are both,
+// and which one a punctuator is depends on whether an operand came before it.
+
+struct OperatorTable {
+  constexpr OperatorTable() : binary{}, prefix{} {
+    struct Entry {
+      const char*  text;
+      Precedence   prec;
+      OperatorKind kind;
+    };
+
+    const Entry entries[] = {
+      { ",",   PREC_COMMA,          OP_BINARY },
+      { "=",   PREC_ASSIGN,         OP_ASSIGN },
+      { "*=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "/=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "%=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "+=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "-=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "<<=", PREC_ASSIGN,         OP_ASSIGN },
+      { ">>=", PREC_ASSIGN,         OP_ASSIGN },
+      { "&=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "^=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "|=",  PREC_ASSIGN,         OP_ASSIGN },
+      { "?",   PREC_CONDITIONAL,    OP_CONDITIONAL },
+      { "||",  PREC_LOGICAL_OR,     OP_BINARY },
+      { "&&",  PREC_LOGICAL_AND,    OP_BINARY },
+      { "|",   PREC_BIT_OR,         OP_BINARY },
+      { "^",   PREC_BIT_XOR,        OP_BINARY },
+      { "&",   PREC_BIT_AND,        OP_BINARY },
+      { "==",  PREC_EQUALITY,       OP_BINARY },
+      { "!=",  PREC_EQUALITY,       OP_BINARY },
+      { "<",   PREC_RELATIONAL,     OP_BINARY },
+      { ">",   PREC_RELATIONAL,     OP_BINARY },
+      { "<=",  PREC_RELATIONAL,     OP_BINARY },
+      { ">=",  PREC_RELATIONAL,     OP_BINARY },
+      { "<<",  PREC_SHIFT,          OP_BINARY },
+      { ">>",  PREC_SHIFT,          OP_BINARY },
+      { "+",   PREC_ADDITIVE,       OP_BINARY },
+      { "-",   PREC_ADDITIVE,       OP_BINARY },
+      { "*",   PREC_MULTIPLICATIVE, OP_BINARY },
+      { "/",   PREC_MULTIPLICATIVE, OP_BINARY },
+      { "%",   PREC_MULTIPLICATIVE, OP_BINARY },
+    };
+
+    for (auto& e : entries) {
+      auto& op = binary[punct_id(e.text)];
+      op.prec = e.prec;
+      op.kind = e.kind;
+    }
+
+    for (auto p : { "&", "*", "+", "-", "~", "!", "++", "--" }) {
+      prefix[punct_id(p)] = true;
+    }
+  }
+
+  bool right_assoc(int id) const {
+    return binary[id].kind == OP_ASSIGN || binary[id].kind == OP_CONDITIONAL;
+  }
+
+  OperatorInfo binary[punct_count];  // id 0, "not a punctuator", stays OP_NONE
+  bool         prefix[punct_count];
+};
+
+inline constexpr OperatorTable operator_table;
+
+static_assert(operator_table.binary[punct_id("*")].prec > operator_table.binary[punct_id("+")].prec);
+static_assert(operator_table.binary[punct_id("=")].kind == OP_ASSIGN);
+static_assert(operator_table.binary[punct_id("~")].kind == OP_NONE);
+
+//------------------------------------------------------------------------------
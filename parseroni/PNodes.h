@@ -1,11 +1,13 @@
 #pragma once
 
 #include "parseroni/Combinators.h"
+#include "parseroni/Lexer.h"
 
 #include "metrolib/core/Log.h"
 
 #include <stdint.h>
 #include <vector>
+#include <memory_resource>
 //#include <span>
 #include <assert.h>
 
@@ -16,9 +18,9 @@ void log_span(cspan s, uint32_t color = 0);
 //------------------------------------------------------------------------------
 
 struct PNode {
-  PNode* parent;
-  PNode* next;
-  PNode* prev;
+  PNode* parent = nullptr;
+  PNode* next = nullptr;
+  PNode* prev = nullptr;
   cspan span;
   cspan gap;
 
@@ -26,6 +28,13 @@ struct PNode {
     log_span(span, 0xFF00FF);
     LOG("\n");
   }
+
+  // Moves every span in the node by delta bytes, used when an edit moves
+  // the node's text. Nodes with spans or children of their own extend this.
+  virtual void shift(ptrdiff_t delta) {
+    span.shift(delta);
+    gap.shift(delta);
+  }
 };
 
 //------------------------------------------------------------------------------
@@ -43,37 +52,101 @@ struct PFieldDeclarationList;
 //------------------------------------------------------------------------------
 
 struct PDeclarator {};
-struct PExpression {};
+// Every expression node is a PExpression, so operands can be walked and
+// dumped without knowing what kind of expression they are.
+struct PExpression : public PNode {};
 struct PStatement {};
 struct PDeclaration {};
 
+// Defined up here because the expression nodes below call into theirs.
+struct PToken : public PNode {};
+
 //------------------------------------------------------------------------------
 
 struct PAccessSpecifier : public PNode {
 };
 
+// Arguments are linked through next/prev, arg_head is null for "()".
 struct PArgumentList : public PNode {
   PToken*      lit_lparen;
   PExpression* arg_head;
   PExpression* arg_tail;
   PToken*      lit_rparen;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    lit_lparen->dump();
+    for (PNode* a = arg_head; a; a = a->next) a->dump();
+    lit_rparen->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    lit_lparen->shift(delta);
+    for (PNode* a = arg_head; a; a = a->next) a->shift(delta);
+    lit_rparen->shift(delta);
+  }
 };
 
-struct PAssignmentExpression : public PNode, public PExpression {
+struct PAssignmentExpression : public PExpression {
   PExpression* lhs;
   PToken*      op;
   PExpression* rhs;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    lhs->dump();
+    op->dump();
+    rhs->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    lhs->shift(delta);
+    op->shift(delta);
+    rhs->shift(delta);
+  }
 };
 
-struct PBinaryExpression : public PNode, public PExpression {
+struct PBinaryExpression : public PExpression {
   PExpression* lhs;
   PToken*      op;
   PExpression* rhs;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    lhs->dump();
+    op->dump();
+    rhs->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    lhs->shift(delta);
+    op->shift(delta);
+    rhs->shift(delta);
+  }
 };
 
-struct PCallExpression : public PNode {
-  PFieldExpression* field;
-  PArgumentList*    args;
+struct PCallExpression : public PExpression {
+  PExpression*   function;
+  PArgumentList* args;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    function->dump();
+    args->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    function->shift(delta);
+    args->shift(delta);
+  }
 };
 
 struct PClassSpecifier : public PNode {
@@ -93,6 +166,33 @@ struct PCompoundStatement : public PNode {
 
 struct PConditionClause : public PNode {};
 
+struct PConditionalExpression : public PExpression {
+  PExpression* condition;
+  PToken*      lit_question;
+  PExpression* consequence;
+  PToken*      lit_colon;
+  PExpression* alternative;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    condition->dump();
+    lit_question->dump();
+    consequence->dump();
+    lit_colon->dump();
+    alternative->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    condition->shift(delta);
+    lit_question->shift(delta);
+    consequence->shift(delta);
+    lit_colon->shift(delta);
+    alternative->shift(delta);
+  }
+};
+
 struct PFieldExpression : public PNode {};
 
 struct PFieldDeclarationList : public PNode {};
@@ -113,6 +213,28 @@ struct PIfStatement : public PNode {
   PStatement*       alternative;
 };
 
+// a.b and a->b
+struct PMemberExpression : public PExpression {
+  PExpression* object;
+  PToken*      op;
+  PIdentifier* member;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    object->dump();
+    op->dump();
+    member->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    object->shift(delta);
+    op->shift(delta);
+    member->shift(delta);
+  }
+};
+
 struct PNamespaceIdentifier : public PNode {};
 
 struct PParameterList : public PNode {
@@ -122,6 +244,46 @@ struct PParameterList : public PNode {
   PToken*      lit_rparen;
 };
 
+struct PParenExpression : public PExpression {
+  PToken*      lit_lparen;
+  PExpression* expression;
+  PToken*      lit_rparen;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    lit_lparen->dump();
+    expression->dump();
+    lit_rparen->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    lit_lparen->shift(delta);
+    expression->shift(delta);
+    lit_rparen->shift(delta);
+  }
+};
+
+// x++ and x--
+struct PPostfixExpression : public PExpression {
+  PExpression* operand;
+  PToken*      op;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    operand->dump();
+    op->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    operand->shift(delta);
+    op->shift(delta);
+  }
+};
+
 //------------------------------------------------------------------------------
 
 struct PPreproc : public PNode {
@@ -152,10 +314,23 @@ struct PPreprocInclude : public PPreproc {
     log_span(lit_path,    0xFFFF00);
     LOG("\n");
   }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    lit_include.shift(delta);
+    lit_ws.shift(delta);
+    lit_path.shift(delta);
+  }
 };
 
 //------------------------------------------------------------------------------
 
+// An identifier, a number, a character literal or a run of adjacent string
+// literals, which C treats as one string.
+struct PPrimaryExpression : public PExpression {
+  LexType type;  // of the first token
+};
+
 struct PQualifiedIdentifier : public PNode {
   PNamespaceIdentifier* scope;
   PToken* lit_coloncolon;
@@ -172,7 +347,29 @@ struct PSpace : public PNode {};
 
 struct PStringLiteral : public PNode {};
 
-struct PToken : public PNode {};
+struct PSubscriptExpression : public PExpression {
+  PExpression* array;
+  PToken*      lit_lbracket;
+  PExpression* index;
+  PToken*      lit_rbracket;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    array->dump();
+    lit_lbracket->dump();
+    index->dump();
+    lit_rbracket->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    array->shift(delta);
+    lit_lbracket->shift(delta);
+    index->shift(delta);
+    lit_rbracket->shift(delta);
+  }
+};
 
 struct PTemplateArgumentList : public PNode {};
 
@@ -191,12 +388,44 @@ struct PTemplateType : public PNode {
 };
 
 struct PTranslationUnit : public PNode {
-  std::vector<PNode*> children;
+  PTranslationUnit(std::pmr::memory_resource* mem = std::pmr::get_default_resource())
+  : children(mem), lookahead(mem) {}
+
+  std::pmr::vector<PNode*> children;
+
+  // Per child, how many bytes past its end its parse looked at - including
+  // what alternatives that lost scanned. Parser::apply_edit() reparses every
+  // child whose lookahead reaches the edit.
+  std::pmr::vector<uint32_t> lookahead;
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    for (auto c : children) c->shift(delta);
+  }
 };
 
 struct PTypeIdentifier : public PNode {
 };
 
+// Prefix operators and sizeof.
+struct PUnaryExpression : public PExpression {
+  PToken*      op;
+  PExpression* operand;
+
+  void dump() override {
+    PNode::dump();
+    LOG_INDENT_SCOPE();
+    op->dump();
+    operand->dump();
+  }
+
+  void shift(ptrdiff_t delta) override {
+    PNode::shift(delta);
+    op->shift(delta);
+    operand->shift(delta);
+  }
+};
+
 struct PUsingDeclaration : public PNode {
   PToken*      lit_using;
   PToken*      lit_namespace;
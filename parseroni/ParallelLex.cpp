@@ -0,0 +1,150 @@
+#include "parseroni/ParallelLex.h"
+
+#include "parseroni/WorkPool.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// One speculative run over a chunk.
+
+struct SpecRun {
+  // Is 'offset' a token boundary in this run?
+  bool has_boundary(uint32_t offset) const {
+    if (offset == start) return true;
+    return std::binary_search(tokens.ends.begin(), tokens.ends.end(), offset);
+  }
+
+  uint32_t start = 0;
+  uint32_t stop = 0;   // where lexing stopped
+  bool     valid = false;
+  TokenBuffer tokens;
+};
+
+//------------------------------------------------------------------------------
+// Guess at where we'd come out if 'offset' were inside a string literal or a
+// block comment - just past whichever terminator comes first.
+
+static const char* skip_string_or_comment(const char* text, const char* end) {
+  for (auto c = text; c < end; c++) {
+    if (*c == '\\' && c[1]) {
+      c++;
+    }
+    else if (*c == '"') {
+      return c + 1;
+    }
+    else if (c[0] == '*' && c[1] == '/') {
+      return c + 2;
+    }
+  }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Append run's tokens that end after 'from'.
+
+static void append_after(TokenBuffer& out, const SpecRun& run, uint32_t from) {
+  auto& ends = run.tokens.ends;
+  auto first = std::upper_bound(ends.begin(), ends.end(), from) - ends.begin();
+  out.types.insert(out.types.end(), run.tokens.types.begin() + first, run.tokens.types.end());
+  out.ends.insert(out.ends.end(), ends.begin() + first, ends.end());
+}
+
+//------------------------------------------------------------------------------
+
+bool lex_all_parallel(const char* text, size_t size, TokenBuffer& out,
+                      WorkPool& pool, size_t chunk_size) {
+  assert(size <= UINT32_MAX);
+  assert(text[size] == 0);
+
+  if (chunk_size == 0) chunk_size = 1;
+  size_t chunk_count = (size + chunk_size - 1) / chunk_size;
+  if (chunk_count <= 1) return lex_all(text, size, out);
+
+  // runs[2 * k] is chunk k from normal code, runs[2 * k + 1] from inside a
+  // string/comment. Chunk 0 starts at the top of the file, so its first run is
+  // exact and it doesn't need a second.
+  std::vector<SpecRun> runs(chunk_count * 2);
+
+  for (size_t k = 0; k < chunk_count; k++) {
+    uint32_t begin = uint32_t(k * chunk_size);
+    uint32_t stop  = uint32_t(std::min(size, (k + 1) * chunk_size));
+
+    pool.push([&runs, text, k, begin, stop](int) {
+      auto& run = runs[2 * k];
+      run.start = begin;
+      run.stop  = lex_range(text, begin, stop, run.tokens);
+      run.valid = true;
+    });
+
+    if (k == 0) continue;
+
+    pool.push([&runs, text, k, begin, stop](int) {
+      auto& run = runs[2 * k + 1];
+      auto resume = skip_string_or_comment(text + begin, text + stop);
+      if (!resume) return;
+      run.start = uint32_t(resume - text);
+      run.stop  = lex_range(text, run.start, stop, run.tokens);
+      run.valid = true;
+    });
+  }
+
+  pool.wait();
+
+  //----------------------------------------
+  // Stitch. 'pos' is where the real token stream has got to.
+
+  out.clear();
+  out.types.reserve(size / 4 + 16);
+  out.ends.reserve(size / 4 + 16);
+
+  uint32_t pos = 0;
+
+  for (size_t k = 0; k < chunk_count; k++) {
+    uint32_t stop = uint32_t(std::min(size, (k + 1) * chunk_size));
+
+    // The previous chunk's last token may have run through this whole chunk.
+    if (pos >= stop) continue;
+
+    while (1) {
+      const SpecRun* synced = nullptr;
+      for (int i = 0; i < 2; i++) {
+        auto& run = runs[2 * k + i];
+        if (run.valid && run.start <= pos && run.has_boundary(pos)) {
+          synced = &run;
+          break;
+        }
+      }
+
+      if (synced) {
+        append_after(out, *synced, pos);
+        pos = synced->stop;
+        // A speculative run that failed after syncing means the real lex
+        // fails at the same byte.
+        if (pos < stop) return false;
+        break;
+      }
+
+      // No luck - take one real token and try again.
+      LexType type;
+      if (auto splice = match_splice(text + pos)) {
+        pos = uint32_t(splice - text);
+        out.push(LEX_SPLICE, pos);
+      }
+      else if (auto end = lex_next(text + pos, type)) {
+        pos = uint32_t(end - text);
+        out.push(type, pos);
+      }
+      else {
+        return false;
+      }
+
+      if (pos >= stop) break;
+    }
+  }
+
+  return pos >= size;
+}
+
+//------------------------------------------------------------------------------
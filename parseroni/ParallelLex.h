@@ -0,0 +1,24 @@
+#pragma once
+
+#include "parseroni/Lexer.h"
+
+#include <stddef.h>
+
+class WorkPool;
+
+//------------------------------------------------------------------------------
+// Lexes one big buffer on several threads. The output is always exactly what
+// lex_all() would produce.
+//
+// The buffer is cut into chunks. Each chunk is lexed speculatively twice, once
+// as if the chunk started in normal code and once as if it started inside a
+// string or block comment (i.e. from just past the next '"' or "*/"). The
+// chunks are then stitched in order: the real token stream coming out of the
+// previous chunk ends at some offset, and whichever speculative run also has a
+// token boundary there is, from that point on, the real stream too. If
+// neither does, we lex on sequentially until one of them lines up.
+
+bool lex_all_parallel(const char* text, size_t size, TokenBuffer& out,
+                      WorkPool& pool, size_t chunk_size = 1 << 20);
+
+//------------------------------------------------------------------------------
@@ -1,9 +1,13 @@
 #include "parseroni/Parser.h"
 
 #include "parseroni/Combinators.h"
+#include "parseroni/Instrument.h"
+#include "parseroni/Lexer.h"
+#include "parseroni/Stream.h"
 
 #include "metrolib/core/Log.h"
 
+#include <algorithm>
 #include <memory>
 #include <string.h>
 #include <assert.h>
@@ -223,18 +227,99 @@ void log_span(cspan s, uint32_t color) {
 //------------------------------------------------------------------------------
 
 void Parser::load(const std::string& text) {
+  mapped.close();
   source = text;
+  source.push_back(0);
+  reset(source.data(), source.size() - 1);
+}
 
-  while(source.size() && source.back() == 0) source.pop_back();
+void Parser::load_translated(const std::string& text) {
+  mapped.close();
+  SpliceMap map;
+  if (!translate_source(text.c_str(), text.size(), source, map)) source = text;
   source.push_back(0);
+  reset(source.data(), source.size() - 1);
+  splices.swap(map);
 
-  source_start = source.data();
-  source_end = source.data() + source.size() - 1;
+  // Locations are reported against the text as it was written.
+  if (!splices.empty()) {
+    original = text;
+    lines.reset(original.data(), original.size());
+  }
+}
+
+bool Parser::load_file(const char* path) {
+  source.clear();
+  if (!mapped.open(path)) {
+    reset("", 0);
+    return false;
+  }
+  reset(mapped.data, mapped.size);
+  return true;
+}
+
+void Parser::load_view(const char* text, size_t size) {
+  assert(text[size] == 0);
+  mapped.close();
+  source.clear();
+  reset(text, size);
+}
+
+bool Parser::parse_stream(int fd, const std::function<void(PNode*, uint64_t)>& on_node,
+                          size_t window_size) {
+  mapped.close();
+  source.clear();
+
+  StreamReader in;
+  if (!in.open(fd, window_size)) return false;
+
+  bool ok = false;
+  size_t used = 0;
+
+  while (in.advance(used)) {
+    reset(in.data, in.size);
+
+    // A node whose parse looked at the end of the window - one that ends too
+    // close to it, or that only won because a comment, literal or #include
+    // path ran into it - waits for the next one.
+    while (cursor < source_end) {
+      auto begin = cursor;
+      auto node = take_toplevel();
+      bool held = !node || (!in.eof && toplevel_reach > source_end);
+      if (held) {
+        cursor = begin;
+        break;
+      }
+      on_node(node, in.offset + uint64_t(begin - source_start));
+    }
+
+    used = size_t(cursor - source_start);
+    if (in.eof) {
+      ok = cursor == source_end;
+      break;
+    }
+  }
+
+  reset("", 0);
+  return ok && !in.failed;
+}
+
+void Parser::reset(const char* text, size_t size) {
+  // Trailing NULs would stop the matchers before source_end.
+  while(size && text[size - 1] == 0) size--;
+
+  source_start = text;
+  source_end = text + size;
   assert(source_end[0]  == 0);
 
   cursor = source_start;
-  // why does stack have no clear();
-  cursor_stack = std::stack<const char*>();
+  arena.reset();
+  if (use_memo) memo.clear();
+  unit = nullptr;
+  cursor_stack.clear();
+  splices.clear();
+  original.clear();
+  lines.reset(source_start, size);
 }
 
 //------------------------------------------------------------------------------
@@ -312,28 +397,12 @@ keywords:
 */
 
 std::optional<cspan> Parser::take_token() {
-  const char* end = nullptr;
-
-  if (end = match_identifier(cursor)) {
-    return take_span(end);
-  }
-  else if (end = match_int(cursor)) {
-    return take_span(end);
-  }
-  else if (end = match_float(cursor)) {
-    return take_span(end);
-  }
-  else if (end = match_preproc(cursor)) {
-    return take_span(end);
-  }
-  else if (end = match_string(cursor)) {
-    return take_span(end);
-  }
-  else if (end = match_punct(cursor)) {
-    return take_span(end);
-  }
+  LexType type;
+  return take_token(type);
+}
 
-  return std::nullopt;
+std::optional<cspan> Parser::take_token(LexType& type) {
+  return PROBE_CALL("take_token", take_span(token_dispatch.match(cursor, type)));
 }
 
 //------------------------------------------------------------------------------
@@ -501,27 +570,19 @@ std::optional<cspan> Parser::take_digits(int base) {
 //------------------------------------------------------------------------------
 
 std::optional<cspan> Parser::take_ws() {
-  start_span();
-  skip_ws();
-
-  if (top_span().empty()) {
-    return drop_span();
-  }
-  else {
-    return take_top_span();
-  }
+  return PROBE_CALL("take_ws", take(scan_ws));
 }
 
 std::optional<cspan> Parser::take_ws_opt() {
-  start_span();
+  auto begin = cursor;
   skip_ws();
-  return take_top_span();
+  return cspan(begin, cursor);
 }
 
 //------------------------------------------------------------------------------
 
 std::optional<cspan> Parser::take(matcher m) {
-  return take_range(cursor, m(cursor));
+  return PROBE_CALL("take(matcher)", take_span(m(cursor)));
 }
 
 //------------------------------------------------------------------------------
@@ -539,14 +600,17 @@ const char* match_lit(const char* text, const char* lit) {
 
 
 std::optional<cspan> Parser::take_lit(const char* lit) {
-  return take_range(cursor, match_lit(cursor, lit));
+  return PROBE_CALL("take_lit", take_span(match_lit(cursor, lit)));
 }
 
-std::optional<cspan> Parser::take_lit(const std::vector<const char*>& lits) {
-  for(auto lit : lits) {
-    if (auto r = take_lit(lit)) return r;
-  }
-  return std::nullopt;
+std::optional<cspan> Parser::take_punct() {
+  return take_span(scan_punct(cursor));
+}
+
+std::optional<cspan> Parser::take_punct(int id) {
+  int found;
+  auto end = scan_punct_id(cursor, found);
+  return found == id ? take_span(end) : std::nullopt;
 }
 
 std::optional<cspan> Parser::take_range(const char* begin, const char* end) {
@@ -562,33 +626,416 @@ std::optional<cspan> Parser::take_range(const char* begin, const char* end) {
 //------------------------------------------------------------------------------
 
 PPreprocInclude* Parser::take_preproc_include() {
-  start_span();
+  return PROBE_CALL("take_preproc_include", memoize_node(RULE_PREPROC_INCLUDE, [this]() -> PPreprocInclude* {
+    Checkpoint cp(*this);
 
-  auto lit_include = take_lit("#include");
-  auto lit_ws      = take(match_ws);
-  auto lit_path    = take(match_include_path);
+    auto lit_include = take<Lit<"#include">>();
+    auto lit_ws      = take(scan_ws);
+    auto lit_path    = take(match_include_path);
 
-  if (lit_include && lit_ws && lit_path) {
-    PPreprocInclude* result = new PPreprocInclude();
+    if (!lit_include || !lit_ws || !lit_path) return nullptr;
+
+    auto result = arena.create<PPreprocInclude>();
 
     result->lit_include = lit_include.value();
     result->lit_ws      = lit_ws.value();
     result->lit_path    = lit_path.value();
 
-    result->span = take_top_span();
+    result->span = cp.commit();
+    return result;
+  }));
+}
+
+//------------------------------------------------------------------------------
+// Expressions
+
+static PToken* new_token(Arena& arena, cspan s) {
+  auto result = arena.create<PToken>();
+  result->span = s;
+  return result;
+}
+
+void Parser::skip_gap() {
+  while (true) {
+    // Gaps inside expressions are mostly nothing or a single space, not
+    // worth a vector scan.
+    while (*cursor == ' ') cursor++;
+    if (*cursor >= '\t' && *cursor <= '\r') cursor = skip_ws_run(cursor);
+
+    const char* end = nullptr;
+    if (cursor[0] == '/' && cursor[1] == '/') {
+      end = match_oneline_comment(cursor);
+    }
+    else if (cursor[0] == '/' && cursor[1] == '*') {
+      end = scan_multiline_comment(cursor);
+    }
+    else if (cursor[0] == '\\') {
+      if (cursor[1] == '\n') end = cursor + 2;
+      else if (cursor[1] == '\r' && cursor[2] == '\n') end = cursor + 3;
+    }
+
+    if (!end) return;
+    cursor = end;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+PExpression* Parser::take_primary_expression() {
+  Checkpoint cp(*this);
+  skip_gap();
+  auto begin = cursor;
+
+  if (*cursor == '(') {
+    auto lparen = take_span(cursor + 1);
+    auto expression = take_expression();
+    skip_gap();
+    auto rparen = take_punct(punct_id(")"));
+    if (!expression || !rparen) return nullptr;
+
+    auto result = arena.create<PParenExpression>();
+    result->lit_lparen = new_token(arena, *lparen);
+    result->expression = expression;
+    result->lit_rparen = new_token(arena, *rparen);
+    result->span = cspan(begin, cursor);
+    cp.commit();
     return result;
   }
-  else {
-    drop_span();
-    return nullptr;
+
+  LexType type;
+  auto end = lex_next(cursor, type);
+  if (!end) return nullptr;
+
+  switch (type) {
+    case LEX_IDENTIFIER:
+    case LEX_INT:
+    case LEX_FLOAT:
+    case LEX_CHAR_LITERAL:
+      cursor = end;
+      break;
+
+    // "abc" "def" is one string.
+    case LEX_STRING:
+    case LEX_RAW_STRING:
+      cursor = end;
+      while (true) {
+        auto last = cursor;
+        skip_gap();
+        LexType next_type;
+        auto next_end = lex_next(cursor, next_type);
+        if (!next_end || (next_type != LEX_STRING && next_type != LEX_RAW_STRING)) {
+          cursor = last;
+          break;
+        }
+        cursor = next_end;
+      }
+      break;
+
+    default:
+      return nullptr;
+  }
+
+  auto result = arena.create<PPrimaryExpression>();
+  result->type = type;
+  result->span = cspan(begin, cursor);
+  cp.commit();
+  return result;
+}
+
+//------------------------------------------------------------------------------
+
+PArgumentList* Parser::take_argument_list() {
+  Checkpoint cp(*this);
+  skip_gap();
+  auto begin = cursor;
+
+  auto lparen = take_punct(punct_id("("));
+  if (!lparen) return nullptr;
+
+  auto result = arena.create<PArgumentList>();
+  result->lit_lparen = new_token(arena, *lparen);
+
+  skip_gap();
+  auto rparen = take_punct(punct_id(")"));
+
+  while (!rparen) {
+    auto arg = take_assignment_expression();
+    if (!arg) return nullptr;
+
+    arg->parent = result;
+    if (result->arg_tail) {
+      result->arg_tail->next = arg;
+      arg->prev = result->arg_tail;
+    }
+    else {
+      result->arg_head = arg;
+    }
+    result->arg_tail = arg;
+
+    skip_gap();
+    if (take_punct(punct_id(","))) continue;
+    rparen = take_punct(punct_id(")"));
+    if (!rparen) return nullptr;
+  }
+
+  result->lit_rparen = new_token(arena, *rparen);
+  result->span = cspan(begin, cursor);
+  cp.commit();
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Prefix operators apply to a whole unary expression, so "-a[i]++" is
+// "-((a[i])++)" - postfix binds tighter, as in the grammar.
+
+PExpression* Parser::take_unary_expression() {
+  OperatorPeek next;
+  return take_unary_expression(next);
+}
+
+PExpression* Parser::take_unary_expression(OperatorPeek& next) {
+  Checkpoint cp(*this);
+  next.id = 0;
+  skip_gap();
+  auto begin = cursor;
+
+  int id;
+  auto end = scan_punct_id(cursor, id);
+
+  std::optional<cspan> op;
+  if (end && operator_table.prefix[id]) {
+    op = take_span(end);
+  }
+  else if (*cursor == 's') {
+    op = take_keyword(KW_SIZEOF);
+  }
+
+  if (op) {
+    auto operand = take_unary_expression(next);
+    if (!operand) return nullptr;
+
+    auto result = arena.create<PUnaryExpression>();
+    result->op = new_token(arena, *op);
+    result->operand = operand;
+    result->span = cspan(begin, cursor);
+    cp.commit();
+    return result;
+  }
+
+  auto result = take_primary_expression();
+  if (!result) return nullptr;
+
+  // Postfix operators, left to right. Anything that doesn't finish leaves the
+  // cursor after the last one that did, and the punctuator that stopped the
+  // loop goes back in 'next' for take_expression().
+  while (true) {
+    auto last = cursor;
+    next = peek_operator();
+    cursor = next.begin;
+
+    PExpression* node = nullptr;
+
+    switch (next.id) {
+      case punct_id("++"):
+      case punct_id("--"): {
+        auto postfix = arena.create<PPostfixExpression>();
+        postfix->operand = result;
+        postfix->op = new_token(arena, *take_span(next.end));
+        node = postfix;
+        break;
+      }
+
+      case punct_id("["): {
+        auto lbracket = take_span(next.end);
+        auto index = take_expression();
+        skip_gap();
+        auto rbracket = take_punct(punct_id("]"));
+        if (!index || !rbracket) break;
+
+        auto subscript = arena.create<PSubscriptExpression>();
+        subscript->array = result;
+        subscript->lit_lbracket = new_token(arena, *lbracket);
+        subscript->index = index;
+        subscript->lit_rbracket = new_token(arena, *rbracket);
+        node = subscript;
+        break;
+      }
+
+      case punct_id("("): {
+        auto args = take_argument_list();
+        if (!args) break;
+
+        auto call = arena.create<PCallExpression>();
+        call->function = result;
+        call->args = args;
+        node = call;
+        break;
+      }
+
+      case punct_id("."):
+      case punct_id("->"): {
+        auto op_span = take_span(next.end);
+        skip_gap();
+        auto name_end = scan_identifier(cursor);
+        if (!name_end || classify_keyword(cursor, name_end) != KW_NONE) break;
+
+        auto member = arena.create<PIdentifier>();
+        member->span = *take_span(name_end);
+
+        auto access = arena.create<PMemberExpression>();
+        access->object = result;
+        access->op = new_token(arena, *op_span);
+        access->member = member;
+        node = access;
+        break;
+      }
+    }
+
+    if (!node) {
+      cursor = last;
+      break;
+    }
+
+    node->span = cspan(begin, cursor);
+    result = node;
+  }
+
+  cp.commit();
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Precedence climbing. Each trip round the loop takes one operator at or
+// above min_prec and its right operand, which is parsed with min_prec raised
+// past this operator's level (left-associative) or left at it (right-
+// associative), so it only swallows operators that bind tighter. The left
+// operand never recurses - "a + b + c + d" is one loop, not a call per '+'.
+//
+// The operator after an operand is peeked once and handed back up through
+// 'next', instead of every pending level scanning it again on the way out.
+
+Parser::OperatorPeek Parser::peek_operator() {
+  auto saved = cursor;
+  skip_gap();
+  OperatorPeek result;
+  result.begin = cursor;
+  result.end = scan_punct_id(cursor, result.id);
+  cursor = saved;
+  return result;
+}
+
+PExpression* Parser::take_expression(int min_prec) {
+  OperatorPeek next;
+  return take_expression(min_prec, next);
+}
+
+PExpression* Parser::take_expression(int min_prec, OperatorPeek& next) {
+  auto lhs = take_unary_expression(next);
+  if (!lhs) return nullptr;
+
+  while (true) {
+    auto& op = operator_table.binary[next.id];
+    if (op.kind == OP_NONE || op.prec < min_prec) return lhs;
+
+    auto last = cursor;
+    auto op_span = cspan(next.begin, next.end);
+    int rhs_prec = operator_table.right_assoc(next.id) ? op.prec : op.prec + 1;
+    cursor = next.end;
+
+    if (op.kind == OP_CONDITIONAL) {
+      // The middle operand is bracketed by '?' and ':', so anything goes.
+      auto consequence = take_expression();
+      skip_gap();
+      auto colon = take_punct(punct_id(":"));
+      auto alternative = (consequence && colon) ? take_expression(rhs_prec, next) : nullptr;
+      if (!alternative) {
+        // Nothing further up can use what's here either.
+        cursor = last;
+        next.id = 0;
+        return lhs;
+      }
+
+      auto node = arena.create<PConditionalExpression>();
+      node->condition    = lhs;
+      node->lit_question = new_token(arena, op_span);
+      node->consequence  = consequence;
+      node->lit_colon    = new_token(arena, *colon);
+      node->alternative  = alternative;
+      node->span = cspan(lhs->span.begin, cursor);
+      lhs = node;
+      continue;
+    }
+
+    auto rhs = take_expression(rhs_prec, next);
+    if (!rhs) {
+      cursor = last;
+      next.id = 0;
+      return lhs;
+    }
+
+    if (op.kind == OP_ASSIGN) {
+      auto node = arena.create<PAssignmentExpression>();
+      node->lhs = lhs;
+      node->op  = new_token(arena, op_span);
+      node->rhs = rhs;
+      node->span = cspan(lhs->span.begin, cursor);
+      lhs = node;
+    }
+    else {
+      auto node = arena.create<PBinaryExpression>();
+      node->lhs = lhs;
+      node->op  = new_token(arena, op_span);
+      node->rhs = rhs;
+      node->span = cspan(lhs->span.begin, cursor);
+      lhs = node;
+    }
   }
 }
 
 //------------------------------------------------------------------------------
 
-// const char* lits[] = {"void", "char", "short", "int", "long", "float", "double" };
-// const char* lits[] = { "signed", "unsigned" };
-// const char* lits[] = { "auto", "register", "static", "extern", "typedef" };
+// One identifier scan plus a perfect-hash lookup, instead of trying each
+// keyword with take_lit in turn.
+
+std::optional<cspan> Parser::take_keyword(Keyword keyword) {
+  auto end = scan_identifier(cursor);
+  if (!end || classify_keyword(cursor, end) != keyword) return std::nullopt;
+  return take_span(end);
+}
+
+std::optional<cspan> Parser::take_keyword(KeywordSet keywords) {
+  auto end = scan_identifier(cursor);
+  if (!end || !(keywords & (KeywordSet(1) << classify_keyword(cursor, end)))) return std::nullopt;
+  return take_span(end);
+}
+
+//------------------------------------------------------------------------------
+// storage_class_specifier = auto | register | static | extern | typedef | _Thread_local
+
+std::optional<cspan> Parser::take_storage_class_specifier() {
+  return take_keyword(kw_storage_class);
+}
+
+//------------------------------------------------------------------------------
+// type-qualifier = const | volatile | restrict | _Atomic
+
+std::optional<cspan> Parser::take_type_qualifier() {
+  return take_keyword(kw_type_qualifier);
+}
+
+//------------------------------------------------------------------------------
+// primitive_type = void | char | short | int | long | float | double | _Bool | _Complex
+
+std::optional<cspan> Parser::take_primitive_type() {
+  return take_keyword(kw_primitive_type);
+}
+
+//------------------------------------------------------------------------------
+// signed_specifier = signed | unsigned
+
+std::optional<cspan> Parser::take_signed_specifier() {
+  return take_keyword(kw_signed);
+}
 
 //------------------------------------------------------------------------------
 /*
@@ -804,18 +1251,6 @@ std::optional<cspan> Parser::take_pointer() {
   return std::nullopt;
 }
 
-//------------------------------------------------------------------------------
-// type-qualifier = const | volatile
-
-std::optional<cspan> Parser::take_type_qualifier() {
-  start_span();
-  if (take("const") || take("volatile")) {
-    return take_top_span();
-  }
-  else {
-    return drop_span();
-  }
-}
 #endif
 
 //------------------------------------------------------------------------------
@@ -824,98 +1259,254 @@ std::optional<cspan> Parser::take_type_qualifier() {
 std::optional<PTranslationUnit*> Parser::take_translation_unit() {
   start_span();
 
-  auto result = std::make_unique<PTranslationUnit>();
+  auto result = arena.create<PTranslationUnit>(&arena);
 
   while(cursor != source_end) {
-    if (auto ws = take_ws()) {
-      auto ws_node = std::make_unique<PNode>();
-      ws_node->span = ws.value();
-      result->children.push_back(ws_node.release());
-    }
+    auto node = take_toplevel();
+    if (!node) break;
+    result->children.push_back(node);
+    result->lookahead.push_back(uint32_t(toplevel_reach - cursor));
   }
 
   result->span = take_top_span();
+  link_children(result);
 
-  return result.release();
+  unit = result;
+  unit_bytes = arena.bytes_used();
+  return result;
 }
 
 //------------------------------------------------------------------------------
 
-bool Parser::parse_digits(const char* s, int base, uint64_t& out) {
-  uint64_t accum = 0;
-  int digits = 0;
+PNode* Parser::take_toplevel() {
+  auto begin = cursor;
+  PNode* node = nullptr;
+  const char* stop = nullptr;  // where a losing alternative gave up, if it matters
+  bool took_include = false;
+  LexType type;
 
-  while (*s) {
-    int digit = 0;
-    if (char_to_digit(*s, base, digit)) {
-      uint64_t old_accum = accum;
-      accum = accum * base + digit;
-      if (accum < old_accum) return false;
-    }
-    else {
+  if (auto ws = take_ws()) {
+    node = arena.create<PSpace>();
+    node->span = ws.value();
+  }
+  else if (auto include = take_preproc_include()) {
+    node = include;
+    took_include = true;
+  }
+  else if (auto comment = take(match_oneline_comment)) {
+    node = arena.create<PComment>();
+    node->span = comment.value();
+  }
+  else if (auto comment = take(scan_multiline_comment)) {
+    node = arena.create<PComment>();
+    node->span = comment.value();
+  }
+  else if (auto token = take_token(type)) {
+    node = arena.create<PToken>();
+    node->span = token.value();
+    stop = lex_fallback_stop(begin, cursor, type);
+  }
+
+  // An #include that didn't parse looked for its path up to the end of the
+  // line.
+  if (!stop && begin[0] == '#' && !took_include && !strncmp(begin, "#include", 8)) {
+    stop = skip_ws_run(begin + 8);
+    while (*stop && *stop != '\n') stop++;
+  }
+
+  auto end = node ? cursor : source_end;
+  toplevel_reach = source_end - end >= ptrdiff_t(stream_lookahead) ? end + stream_lookahead : source_end + 1;
+  if (stop) toplevel_reach = std::max(toplevel_reach, stop + 1);
+
+  return node;
+}
+
+//------------------------------------------------------------------------------
+
+void Parser::link_children(PTranslationUnit* parent) {
+  PNode* prev = nullptr;
+  for (auto c : parent->children) {
+    c->parent = parent;
+    c->prev = prev;
+    c->next = nullptr;
+    if (prev) prev->next = c;
+    prev = c;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Top-level parsing has no state beyond the cursor, so once reparsing lands on
+// the start of an old child that sat after the edit, everything from there on
+// would parse exactly the same and we can keep the old nodes.
+
+PTranslationUnit* Parser::apply_edit(size_t offset, size_t removed_len, const std::string& inserted_text) {
+  edit_reused = 0;
+  edit_reparsed = 0;
+
+  if (!unit) return nullptr;
+
+  size_t old_size = source_end - source_start;
+  if (offset > old_size || removed_len > old_size - offset) return nullptr;
+
+  auto& children  = unit->children;
+  auto& lookahead = unit->lookahead;
+  size_t count = children.size();
+
+  // The first child whose parse looked at the edited text. Lookahead counts
+  // what alternatives that lost scanned too, so an unterminated "/*" long
+  // before the edit still gets reparsed.
+  size_t first = 0;
+  while (first < count && size_t(children[first]->span.end - source_start) + lookahead[first] <= offset) first++;
+
+  // Everything else we need from the old spans, as offsets, before the old
+  // text goes away.
+  edit_begins.clear();
+  for (size_t i = first; i < count; i++) edit_begins.push_back(uint32_t(children[i]->span.begin - source_start));
+  size_t old_unit_end = unit->span.end - source_start;
+  size_t reparse_from = first < count ? edit_begins[0] : old_unit_end;
+
+  // Edit the text in place. A mapped file or a view gets copied in once, after
+  // that only the tail moves - and the buffer only when it has to grow.
+  if (source_start != source.data()) {
+    source.assign(source_start, old_size);
+    source.push_back(0);
+  }
+  auto old_base = uintptr_t(source_start);
+  source.replace(offset, removed_len, inserted_text);
+  mapped.close();
+
+  source_start = source.data();
+  source_end   = source.data() + source.size() - 1;
+  cursor_stack.clear();
+  if (use_memo) memo.clear();
+  splices.clear();
+  original.clear();
+  lines.reset(source_start, source_end - source_start);
+
+  ptrdiff_t base_delta = ptrdiff_t(uintptr_t(source_start) - old_base);
+  ptrdiff_t edit_delta = ptrdiff_t(inserted_text.size()) - ptrdiff_t(removed_len);
+  size_t    edit_end   = offset + removed_len;
+
+  if (base_delta) {
+    for (size_t i = 0; i < first; i++) children[i]->shift(base_delta);
+  }
+
+  cursor = source_start + reparse_from;
+
+  // Old children that started at or after the end of the edit are candidates
+  // for reuse.
+  size_t next = first;
+  while (next < count && edit_begins[next - first] < edit_end) next++;
+
+  auto reused_begin = [&](size_t i) { return source_start + edit_begins[i - first] + edit_delta; };
+
+  edit_nodes.clear();
+  edit_lookahead.clear();
+  size_t kept = count;
+
+  while (1) {
+    while (next < count && reused_begin(next) < cursor) next++;
+
+    if (next < count && reused_begin(next) == cursor) {
+      if (base_delta + edit_delta) {
+        for (size_t i = next; i < count; i++) children[i]->shift(base_delta + edit_delta);
+      }
+      kept = next;
+      edit_reused = count - next;
+      cursor = source_start + old_unit_end + edit_delta;
       break;
     }
-    digits++;
-    s++;
+
+    if (cursor == source_end) break;
+
+    auto node = take_toplevel();
+    if (!node) break;
+    edit_nodes.push_back(node);
+    edit_lookahead.push_back(uint32_t(toplevel_reach - cursor));
+    edit_reparsed++;
+  }
+  edit_reused += first;
+
+  // Splice the reparsed run over the damaged one, in place, so the children
+  // vector only grows when the tree does.
+  children.erase(children.begin() + first, children.begin() + kept);
+  children.insert(children.begin() + first, edit_nodes.begin(), edit_nodes.end());
+  lookahead.erase(lookahead.begin() + first, lookahead.begin() + kept);
+  lookahead.insert(lookahead.begin() + first, edit_lookahead.begin(), edit_lookahead.end());
+  unit->span = cspan(source_start, cursor);
+
+  // Only the links around the splice changed.
+  size_t lo = first ? first - 1 : 0;
+  size_t hi = std::min(first + edit_nodes.size() + 1, children.size());
+  for (size_t i = lo; i < hi; i++) {
+    auto c = children[i];
+    c->parent = unit;
+    c->prev = i ? children[i - 1] : nullptr;
+    c->next = i + 1 < children.size() ? children[i + 1] : nullptr;
   }
 
-  if (isalpha(*s) || digits == 0) {
-    return false;
+  // Once the replaced nodes outweigh the live ones, start over in a clean
+  // arena. Its blocks get reused, so memory stays bounded however many edits
+  // come in.
+  if (arena.bytes_used() > 2 * unit_bytes) {
+    arena.reset();
+    cursor = source_start;
+    take_translation_unit();
+    edit_reused = 0;
+    edit_reparsed = unit->children.size();
   }
 
-  out = accum;
-  return true;
+  return unit;
+}
+
+//------------------------------------------------------------------------------
+
+bool Parser::parse_digits(const char* s, int base, uint64_t& out) {
+  auto end = skip_digits(s, base);
+  if (end == s || isalpha(*end)) return false;
+  return decode_digits(s, end, base, out);
 }
 
 
 bool Parser::parse_int(cspan s, PInt& out) {
-  int base = 0;
+  auto cursor = s.begin;
+
+  bool negative = *cursor == '-';
+  if (negative) cursor++;
+
+  NumberInfo info;
+  auto end = scan_number(cursor, info);
+  if (!end || !info.valid || info.is_float) return false;
+
   uint64_t accum = 0;
+  if (!decode_digits(info.digits, info.digits_end, info.base, accum)) return false;
+  if (negative && accum > 0x8000000000000000) return false;
 
+  out = PInt(cspan(s.begin, end), negative, accum);
+  out.base = info.base;
+  out.longs = info.longs;
+  out.is_unsigned = info.is_unsigned;
+  return true;
+}
+
+
+bool Parser::parse_float(cspan s, PFloat& out) {
   auto cursor = s.begin;
 
   bool negative = *cursor == '-';
   if (negative) cursor++;
 
-  if (*cursor != '0') {
-    // starts with [1-9]
-    base = 10;
-  }
-  else if (isdigit(cursor[1])) {
-    // starts with 0[1-9]
-    cursor += 1;
-    base = 8;
-  }
-  else if (cursor[1] == 'b') {
-    // starts with 0b
-    cursor += 2;
-    base = 2;
-  }
-  else if (cursor[1] == 'x') {
-    // starts with 0x
-    cursor += 2;
-    base = 16;
-  }
-  else if ((ispunct(cursor[1]) && cursor[1] != '_') || cursor[1] == 0) {
-    // bare 0 followed by punctuation
-    out = PInt(s, negative, 0);
-    return true;
-  }
-  else {
-    // bad prefix
-    return false;
-  }
+  NumberInfo info;
+  auto end = scan_number(cursor, info);
+  if (!end) return false;
 
-  if (base && parse_digits(cursor, base, accum)) {
-    if (negative && accum > 0x8000000000000000) {
-      return false;
-    }
-    out = PInt(s, negative, accum);
-    return true;
-  }
-  else {
-    return false;
-  }
+  double value = 0;
+  if (!decode_float(info, value)) return false;
+
+  out = PFloat(cspan(s.begin, end), negative, value);
+  out.is_single = info.is_single;
+  out.is_long = info.longs != 0;
+  return true;
 }
 
 //------------------------------------------------------------------------------
@@ -1,12 +1,21 @@
 #pragma once
 
 #include "parseroni/PNodes.h"
+#include "parseroni/Arena.h"
 #include "parseroni/Combinators.h"
+#include "parseroni/Keywords.h"
+#include "parseroni/LineIndex.h"
+#include "parseroni/MappedFile.h"
+#include "parseroni/Punctuators.h"
+#include "parseroni/Memo.h"
+#include "parseroni/Numbers.h"
+#include "parseroni/Operators.h"
+#include "parseroni/Scanners.h"
+#include "parseroni/Translate.h"
 
 #include "metrolib/core/Result.h"
 
 #include <assert.h>
-#include <stack>
 #include <string>
 #include <stdint.h>
 #include <optional>
@@ -34,6 +43,75 @@ struct PInt {
     int64_t  s_int;
   };
   bool is_negative;
+
+  // From the literal's prefix and suffix.
+  uint8_t base = 10;
+  uint8_t longs = 0;
+  bool is_unsigned = false;
+};
+
+//------------------------------------------------------------------------------
+
+struct PFloat {
+  PFloat() : value(0), is_negative(false) {}
+
+  PFloat(cspan span, bool is_negative, double value) {
+    this->span = span;
+    this->is_negative = is_negative;
+    this->value = is_negative ? -value : value;
+  }
+
+  cspan span;
+  double value;
+  bool is_negative;
+
+  // From the literal's suffix. value is always the nearest double, an f
+  // literal still has to be narrowed by whoever wants it as a float.
+  bool is_single = false;
+  bool is_long = false;
+};
+
+//------------------------------------------------------------------------------
+// Saved cursors for start_span() and friends. Fixed capacity and stored inline
+// in the Parser, so saving and restoring a cursor never touches the allocator.
+// Rules nest rather than loop, so depth is bounded by how deep the grammar
+// recurses - overflowing means a rule forgot to pop.
+
+struct CursorStack {
+  static const int capacity = 1024;
+
+  void push(const char* c) {
+    assert(count < capacity);
+    slots[count++] = c;
+  }
+
+  const char* top() const {
+    assert(count);
+    return slots[count - 1];
+  }
+
+  void pop() {
+    assert(count);
+    count--;
+  }
+
+  bool empty() const { return count == 0; }
+  int  size()  const { return count; }
+  void clear()       { count = 0; }
+
+  const char* slots[capacity];
+  int count = 0;
+};
+
+//------------------------------------------------------------------------------
+// Ids for memoized grammar rules. The live grammar doesn't backtrack yet -
+// the multi-alternative rules like take_type_specifier() are still compiled
+// out - so #include is the only rule memoized for now.
+
+enum RuleId {
+  RULE_PREPROC_INCLUDE,
+  RULE_USER,   // for rules built outside Parser with memoize()
+  RULE_COUNT,
 };
 
 //------------------------------------------------------------------------------
@@ -42,27 +120,130 @@ class Parser {
 public:
 
   Parser() {}
+
+  // Copies text into the parser.
   void load(const std::string& text);
 
+  // Parses a file in place from a padded mmap, no copy.
+  bool load_file(const char* path);
+
+  // Parses a caller-owned buffer in place. text[size] must be readable and
+  // zero, and the buffer must outlive the parse.
+  void load_view(const char* text, size_t size);
+
+  // Copies text into the parser through translate_source(), so the rules
+  // never see a CRLF or a backslash-newline. Spans point into the translated
+  // text - physical_begin()/physical_end() give their offsets in the original.
+  void load_translated(const std::string& text);
+
+  size_t physical_begin(cspan s) const {
+    return splices.to_physical(uint32_t(s.begin - source_start));
+  }
+
+  size_t physical_end(cspan s) const {
+    return splices.to_physical_end(uint32_t(s.end - source_start));
+  }
+
+  // Line and column of p in the original text, for diagnostics. The index is
+  // built on the first call and reused until the next load.
+  SourceLocation locate(const char* p) {
+    return lines.locate(splices.to_physical(uint32_t(p - source_start)));
+  }
+
+  // Parses a pipe or file top-level node by node, a window at a time, in
+  // bounded memory (see StreamReader). Each node goes to on_node with its
+  // offset in the stream, and is only valid until on_node returns. Returns
+  // false on a read error or if the stream doesn't parse to the end.
+  bool parse_stream(int fd, const std::function<void(PNode*, uint64_t offset)>& on_node,
+                    size_t window_size = 1 << 20);
+
   //----------------------------------------
 
   //std::optional<cspan> take(const char* text);
   std::optional<cspan> take_token();
+  std::optional<cspan> take_token(LexType& type);
   std::optional<cspan> take_ws_opt();
   std::optional<cspan> take_ws();
   std::optional<cspan> take(matcher m);
+
+  // Direct-call versions of take(matcher) - function pointers, lambdas and
+  // Matcheroni patterns get inlined instead of going through std::function.
+  template<typename M>
+  std::optional<cspan> take(M&& m) {
+    return take_span(m(cursor));
+  }
+
+  template<typename M>
+  std::optional<cspan> take() {
+    return take_span(M::match(cursor));
+  }
+
   std::optional<cspan> take_lit(const char* lit);
-  std::optional<cspan> take_lit(const std::vector<const char*>& lits);
+
+  // Longest-match punctuator, so "+++" is "++" then "+". The id version only
+  // matches if the longest punctuator here is that one - take_punct(punct_id("+"))
+  // fails on "++".
+  std::optional<cspan> take_punct();
+  std::optional<cspan> take_punct(int id);
   std::optional<cspan> take_range(const char* begin, const char* end);
 
+  // Keywords only match a whole identifier - "int" doesn't match "integer".
+  std::optional<cspan> take_keyword(Keyword keyword);
+  std::optional<cspan> take_keyword(KeywordSet keywords);
+
+  std::optional<cspan> take_storage_class_specifier();
+  std::optional<cspan> take_type_qualifier();
+  std::optional<cspan> take_primitive_type();
+  std::optional<cspan> take_signed_specifier();
+
   PPreprocInclude* take_preproc_include();
 
+  //----------------------------------------
+  // C expressions by precedence climbing over operator_table (Operators.h) -
+  // one loop handles every binary level instead of one rule per level.
+  // Whitespace and comments between tokens are skipped, and each node's span
+  // runs from its first token to its last. Returns nullptr with the cursor
+  // unmoved if there's no expression here; otherwise takes the longest
+  // expression that parses, so "a + )" takes "a".
+  //
+  // Casts and sizeof(type-name) aren't handled - telling "(T)x" from "(a)-b"
+  // needs to know which names are types.
+
+  // Operators at or above min_prec only. The default takes commas too.
+  PExpression* take_expression(int min_prec = PREC_COMMA);
+
+  // What a function argument or an initializer can be - no top-level comma.
+  PExpression* take_assignment_expression() {
+    return take_expression(PREC_ASSIGN);
+  }
+
+  // Prefix operators, then a primary, then any postfix operators.
+  PExpression* take_unary_expression();
+  PExpression* take_primary_expression();
+  PArgumentList* take_argument_list();
+
+  // Whitespace, comments and line splices.
+  void skip_gap();
+
+  // The punctuator after the gap at the cursor, without moving the cursor.
+  struct OperatorPeek {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    int id = 0;
+  };
+  OperatorPeek peek_operator();
+
+  // Versions that also hand back the first punctuator after what they took,
+  // so the caller doesn't have to scan for it again.
+  PExpression* take_expression(int min_prec, OperatorPeek& next);
+  PExpression* take_unary_expression(OperatorPeek& next);
+
   void print_rest() {
     printf("rest : {%s}\n", cursor);
   }
 
   void skip_ws() {
-    while(isspace(*cursor)) cursor++;
+    cursor = skip_ws_run(cursor);
   }
 
   //std::optional<cspan> take(char c);
@@ -86,14 +267,11 @@ public:
   std::optional<cspan> take_include_path();
   std::optional<cspan> take_int();
   std::optional<cspan> take_pointer();
-  std::optional<cspan> take_signed_specifier();
   std::optional<cspan> take_specifier_qualifier();
-  std::optional<cspan> take_storage_class_specifier();
   std::optional<cspan> take_struct_declaration();
   std::optional<cspan> take_struct_declarator_list();
   std::optional<cspan> take_struct_declarator();
   std::optional<cspan> take_struct_or_union_specifier();
-  std::optional<cspan> take_type_qualifier();
   std::optional<cspan> take_type_specifier();
   std::optional<cspan> take_typedef_name();
   std::optional<PInt>  take_int_as_pint();
@@ -104,19 +282,124 @@ public:
 
   std::optional<PTranslationUnit*> take_translation_unit();
 
+  // One top-level child of a translation unit - whitespace, a comment, an
+  // #include or a single token.
+  PNode* take_toplevel();
+
+  // One past the last byte the last take_toplevel() looked at - stream_lookahead
+  // past the node it took, or further if an alternative that lost ran on
+  // looking for its terminator. The NUL at source_end counts, so a node whose
+  // parse could change with more text has a reach past source_end.
+  const char* toplevel_reach = nullptr;
+
+  // Replaces source[offset, offset + removed_len) with inserted_text and
+  // updates the tree from the last take_translation_unit() to match. Only the
+  // children around the edit are reparsed, the rest are kept and shifted.
+  // Returns nullptr if there's no tree or the range is out of bounds.
+  //
+  // Replaced nodes stay in the arena until there's as much dead as live in
+  // there, then the whole file is reparsed into a reset arena - so nodes from
+  // before an edit may be gone after it.
+  PTranslationUnit* apply_edit(size_t offset, size_t removed_len, const std::string& inserted_text);
+
+  PTranslationUnit* unit = nullptr;
+
+  void link_children(PTranslationUnit* parent);
+
+  // How the last apply_edit went.
+  size_t edit_reused = 0;
+  size_t edit_reparsed = 0;
+
+  // arena.bytes_used() after the last take_translation_unit().
+  size_t unit_bytes = 0;
+
+  // Scratch for apply_edit(), reused from edit to edit.
+  std::vector<PNode*>   edit_nodes;
+  std::vector<uint32_t> edit_lookahead;
+  std::vector<uint32_t> edit_begins;
+
   // PNode* take_oneof(taker, ...);
 
   //----------------------------------------
 
+  // Both decode through decode_digits(), eight digits at a time. parse_int
+  // takes an optional '-' and then a whole int literal, suffix included, and
+  // fails on anything malformed or too big for 64 bits.
   static bool parse_digits(const char* s, int base, uint64_t& out);
   static bool parse_int(cspan s, PInt& out);
 
+  // Same for float literals, decimal or hex, through decode_float().
+  static bool parse_float(cspan s, PFloat& out);
+
   //----------------------------------------
 
+  void reset(const char* text, size_t size);
+
   std::string source;
+  MappedFile  mapped;
+
+  // From load_translated(), empty otherwise. apply_edit() works in logical
+  // offsets and drops it, along with the untranslated text.
+  SpliceMap   splices;
+  std::string original;
+  LineIndex   lines;
+
+  // Owns every node returned by take_*. Reset by load(), so trees only live
+  // until the next load or until the parser goes away.
+  Arena arena;
   const char* source_start = nullptr;
   const char* source_end = nullptr;
 
+  //----------------------------------------
+  // Packrat memoization. Off by default - it only pays off once rules start
+  // backtracking into each other. When on, a memoized rule runs at most once
+  // per offset. Cleared by load() when on.
+
+  void enable_memo(bool enable) {
+    use_memo = enable;
+    memo.clear();
+    memo.clear_stats();
+  }
+
+  template<typename F>
+  std::optional<cspan> memoize(RuleId rule, F&& f) {
+    if (!use_memo) return f();
+
+    auto begin = cursor;
+    auto offset = uint32_t(begin - source_start);
+
+    MemoResult r;
+    if (memo.lookup(rule, offset, r)) {
+      if (!r.end) return std::nullopt;
+      cursor = r.end;
+      return cspan(begin, r.end);
+    }
+
+    auto result = f();
+    memo.store(rule, offset, {result ? cursor : nullptr, nullptr});
+    return result;
+  }
+
+  template<typename F>
+  auto memoize_node(RuleId rule, F&& f) -> decltype(f()) {
+    if (!use_memo) return f();
+
+    auto offset = uint32_t(cursor - source_start);
+
+    MemoResult r;
+    if (memo.lookup(rule, offset, r)) {
+      if (r.end) cursor = r.end;
+      return (decltype(f()))r.node;
+    }
+
+    auto node = f();
+    memo.store(rule, offset, {node ? cursor : nullptr, node});
+    return node;
+  }
+
+  bool      use_memo = false;
+  MemoTable memo;
+
   //----------------------------------------
 
   std::string ws;
@@ -124,7 +407,38 @@ public:
   //----------------------------------------
 
   const char* cursor;
-  std::stack<const char*> cursor_stack;
+  CursorStack cursor_stack;
+
+  // Backtracking without the shared stack - the saved cursor lives in the
+  // rule's own stack frame, and is put back when the checkpoint goes out of
+  // scope unless the rule commits.
+  //
+  //   Checkpoint cp(*this);
+  //   if (!take_a() || !take_b()) return std::nullopt;
+  //   return cp.commit();
+
+  struct Checkpoint {
+    Checkpoint(Parser& parser) : parser(parser), saved(parser.cursor) {}
+
+    ~Checkpoint() {
+      if (!committed) parser.cursor = saved;
+    }
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    // Everything taken since the checkpoint.
+    cspan span() const { return cspan(saved, parser.cursor); }
+
+    cspan commit() {
+      committed = true;
+      return span();
+    }
+
+    Parser&     parser;
+    const char* saved;
+    bool        committed = false;
+  };
 
   std::optional<cspan> take_span(const char* end) {
     if (end) {
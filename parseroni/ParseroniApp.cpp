@@ -2,7 +2,258 @@
 
 #include "parseroni/Parser.h"
 
+#include "parseroni/CorpusScan.h"
+#include "parseroni/LineIndex.h"
+#include "parseroni/MappedFile.h"
+#include "parseroni/WorkPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// bin/parseroni - runs the lexer or the parser over a source tree.
+//
+//   parseroni [lex|parse|dump] [-j N] [--cache dir] [--ext .h,.c,...] [-q]
+//             file-or-dir...
+//
+// lex    lexes every file, through a TokenCache with --cache
+// parse  parses every file with take_translation_unit()
+// dump   parses every file and dumps the tree, one file at a time in path
+//        order so the output doesn't depend on -j
+//
+// lex and parse report MB/s, tokens/s (top-level nodes/s for parse), per-file
+// latency percentiles and, for lex, the token histogram. Files that don't
+// lex or parse to the end are listed with the line and column they stopped
+// at, unless -q. Exit code is 1 if any file failed, 2 on bad arguments.
+
+static double now_seconds() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "usage: %s [lex|parse|dump] [-j N] [--cache dir] [--ext .h,.c,...] [-q] file-or-dir...\n", argv0);
+}
+
+//------------------------------------------------------------------------------
+// Same shape as scan_corpus(), with a Parser per thread instead of a
+// TokenBuffer. 'tokens' in each result is the number of top-level nodes.
+
+static CorpusStats parse_corpus(const std::vector<std::string>& paths, const CorpusOptions& options) {
+  double start = now_seconds();
+
+  CorpusStats stats;
+  auto files = find_corpus_files(paths, options, stats);
+
+  WorkPool pool(options.threads);
+
+  struct ThreadState {
+    CorpusStats stats;
+    Parser parser;
+  };
+  std::vector<std::unique_ptr<ThreadState>> threads;
+  for (int i = 0; i < pool.thread_count(); i++) threads.push_back(std::make_unique<ThreadState>());
+
+  for (auto& f : files) {
+    pool.push([&f, &threads](int thread) {
+      auto& state = *threads[thread];
+      auto& p = state.parser;
+      double file_start = now_seconds();
+
+      FileResult result;
+      result.path = f.path;
+
+      if (p.load_file(f.path.c_str())) {
+        auto unit = p.take_translation_unit();
+        result.ok = p.cursor == p.source_end;
+        result.error_offset = result.ok ? 0 : uint32_t(p.cursor - p.source_start);
+        result.bytes = p.source_end - p.source_start;
+        result.tokens = unit ? unit.value()->children.size() : 0;
+      }
+      result.seconds = now_seconds() - file_start;
+
+      state.stats.source_files++;
+      state.stats.failed_files += result.ok ? 0 : 1;
+      state.stats.total_bytes  += result.bytes;
+      state.stats.total_tokens += result.tokens;
+      state.stats.files.push_back(std::move(result));
+    });
+  }
+  pool.wait();
+
+  for (auto& t : threads) stats.merge(t->stats);
+
+  std::sort(stats.files.begin(), stats.files.end(), [](const FileResult& a, const FileResult& b) {
+    return a.path < b.path;
+  });
+
+  stats.seconds = now_seconds() - start;
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+
+static int dump_corpus(const std::vector<std::string>& paths, const CorpusOptions& options) {
+  CorpusStats unused;
+  auto files = find_corpus_files(paths, options, unused);
+  std::sort(files.begin(), files.end(), [](const CorpusFile& a, const CorpusFile& b) {
+    return a.path < b.path;
+  });
+
+  int failed = 0;
+  Parser p;
+  for (auto& f : files) {
+    printf("==== %s\n", f.path.c_str());
+    if (!p.load_file(f.path.c_str())) {
+      fprintf(stderr, "%s: could not read\n", f.path.c_str());
+      failed++;
+      continue;
+    }
+    auto unit = p.take_translation_unit();
+    for (auto child : unit.value()->children) child->dump();
+
+    if (p.cursor != p.source_end) {
+      auto loc = p.locate(p.cursor);
+      fprintf(stderr, "%s:%u:%u: parse stopped here\n", f.path.c_str(), loc.line, loc.col);
+      failed++;
+    }
+  }
+  return failed ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
+
+static double percentile(const std::vector<double>& sorted, double q) {
+  if (sorted.empty()) return 0;
+  size_t i = size_t(q * double(sorted.size() - 1) + 0.5);
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static void report(const CorpusStats& stats, bool lex, int threads, bool quiet) {
+  if (!quiet) {
+    for (auto& f : stats.files) {
+      if (f.ok) continue;
+      if (!f.bytes && !f.tokens) {
+        fprintf(stderr, "%s: could not read\n", f.path.c_str());
+        continue;
+      }
+      MappedFile file;
+      LineIndex lines;
+      SourceLocation loc;
+      if (file.open(f.path.c_str())) {
+        lines.reset(file.data, file.size);
+        loc = lines.locate(f.error_offset);
+      }
+      fprintf(stderr, "%s:%u:%u: %s stopped here\n", f.path.c_str(), loc.line, loc.col, lex ? "lexing" : "parse");
+    }
+  }
+
+  double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+  double mb = double(stats.total_bytes) / (1024.0 * 1024.0);
+  const char* unit = lex ? "tokens" : "nodes";
+
+  printf("files     %zu source of %zu, %zu failed", stats.source_files, stats.total_files, stats.failed_files);
+  if (lex && stats.cache_hits) printf(", %zu from cache", stats.cache_hits);
+  printf("\n");
+  printf("threads   %d\n", threads);
+  printf("bytes     %zu (%.2f MB)\n", stats.total_bytes, mb);
+  printf("%-9s %zu\n", unit, stats.total_tokens);
+  printf("time      %.3f s\n", stats.seconds);
+  printf("speed     %.2f MB/s, %.0f %s/s\n", mb / seconds, double(stats.total_tokens) / seconds, unit);
+
+  std::vector<double> latency;
+  latency.reserve(stats.files.size());
+  for (auto& f : stats.files) latency.push_back(f.seconds * 1e6);
+  std::sort(latency.begin(), latency.end());
+
+  if (!latency.empty()) {
+    printf("latency   p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+           percentile(latency, 0.50), percentile(latency, 0.90),
+           percentile(latency, 0.99), latency.back());
+  }
+
+  if (lex && stats.total_tokens) {
+    printf("\n");
+    for (int i = 0; i < LEX_TYPE_COUNT; i++) {
+      auto count = stats.hit_counts[i];
+      if (!count) continue;
+      printf("%-14s %12llu %6.2f%%\n", lex_type_name(LexType(i)), (unsigned long long)count,
+             100.0 * double(count) / double(stats.total_tokens));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
 int main(int argc, char** argv) {
-  printf("Hello World\n");
-  return 0;
+  enum { MODE_LEX, MODE_PARSE, MODE_DUMP } mode = MODE_LEX;
+  bool quiet = false;
+  CorpusOptions options;
+  std::vector<std::string> paths;
+
+  int first = 1;
+  if (argc > 1) {
+    if      (!strcmp(argv[1], "lex"))   { mode = MODE_LEX;   first = 2; }
+    else if (!strcmp(argv[1], "parse")) { mode = MODE_PARSE; first = 2; }
+    else if (!strcmp(argv[1], "dump"))  { mode = MODE_DUMP;  first = 2; }
+  }
+
+  for (int i = first; i < argc; i++) {
+    auto arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (!strcmp(arg, "-j") && has_value) {
+      options.threads = atoi(argv[++i]);
+    }
+    else if (!strncmp(arg, "-j", 2) && arg[2]) {
+      options.threads = atoi(arg + 2);
+    }
+    else if (!strcmp(arg, "--cache") && has_value) {
+      options.cache_dir = argv[++i];
+    }
+    else if (!strcmp(arg, "--ext") && has_value) {
+      options.extensions.clear();
+      std::string list = argv[++i];
+      size_t begin = 0;
+      while (begin <= list.size()) {
+        auto end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+        if (end > begin) options.extensions.push_back(list.substr(begin, end - begin));
+        begin = end + 1;
+      }
+    }
+    else if (!strcmp(arg, "-q")) {
+      quiet = true;
+    }
+    else if (arg[0] == '-') {
+      usage(argv[0]);
+      return 2;
+    }
+    else {
+      paths.push_back(arg);
+    }
+  }
+
+  if (paths.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (mode == MODE_DUMP) return dump_corpus(paths, options);
+
+  auto stats = mode == MODE_LEX ? scan_corpus(paths, options) : parse_corpus(paths, options);
+
+  // Same rule the pool uses, for the report.
+  int threads = options.threads > 0 ? options.threads : int(std::thread::hardware_concurrency());
+  if (threads <= 0) threads = 1;
+  report(stats, mode == MODE_LEX, threads, quiet);
+
+  return stats.failed_files ? 1 : 0;
 }
+
+//------------------------------------------------------------------------------
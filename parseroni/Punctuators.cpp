@@ -0,0 +1,24 @@
+#include "parseroni/Punctuators.h"
+
+//------------------------------------------------------------------------------
+
+static_assert(punct_trie.node_count > 1);
+static_assert(punct_id("<=>") != 0 && punct_id("<==") == 0);
+
+const char* scan_punct_id(const char* text, int& id) {
+  auto end = punct_trie.match(text, id);
+
+  if (id == punct_id("<:") && end[0] == ':' && end[1] != ':' && end[1] != '>') {
+    id = punct_id("<");
+    return text + 1;
+  }
+
+  return end;
+}
+
+const char* scan_punct(const char* text) {
+  int id;
+  return scan_punct_id(text, id);
+}
+
+//------------------------------------------------------------------------------
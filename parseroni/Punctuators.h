@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// Every C and C++ punctuator, digraphs included. A punctuator's id is its
+// index in this table, and id 0 means "not a punctuator".
+
+inline constexpr const char* punctuators[] = {
+  "",
+  "[", "]", "(", ")", "{", "}", ".", "->", "++", "--", "&", "*", "+", "-", "~",
+  "!", "/", "%", "<<", ">>", "<", ">", "<=", ">=", "==", "!=", "^", "|", "&&",
+  "||", "?", ":", ";", "...", "=", "*=", "/=", "%=", "+=", "-=", "<<=", ">>=",
+  "&=", "^=", "|=", ",", "#", "##",
+  "<:", ":>", "<%", "%>", "%:", "%:%:",
+  "::", ".*", "->*", "<=>",
+};
+
+inline constexpr int punct_count = sizeof(punctuators) / sizeof(punctuators[0]);
+
+// Compile-time id lookup, e.g. punct_id("+=").
+constexpr int punct_id(const char* p) {
+  for (int i = 1; i < punct_count; i++) {
+    auto a = punctuators[i];
+    auto b = p;
+    while (*a && *a == *b) { a++; b++; }
+    if (*a == 0 && *b == 0) return i;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Trie over the punctuator table, built at compile time. Each node is one byte
+// of some punctuator; children of a node are a singly-linked sibling list,
+// which stays short (at most four entries, under '<'). Matching walks the trie
+// once and remembers the last accepting node, so it's longest match in a
+// single pass no matter what order the table is in.
+
+struct PunctTrie {
+  struct Node {
+    char    c;
+    uint8_t punct;    // id if a punctuator ends here, else 0
+    uint8_t child;    // node index, 0 = none
+    uint8_t sibling;  // node index, 0 = none
+  };
+
+  static const int max_nodes = 128;
+
+  constexpr PunctTrie() : nodes{}, node_count(1), roots{} {
+    for (int i = 1; i < punct_count; i++) insert(punctuators[i], i);
+  }
+
+  constexpr void insert(const char* p, int id) {
+    uint8_t* link = &roots[uint8_t(*p)];
+    while (true) {
+      if (!*link) {
+        assert_room();
+        nodes[node_count].c = *p;
+        *link = uint8_t(node_count++);
+      }
+      auto& node = nodes[*link];
+      if (!*++p) {
+        node.punct = uint8_t(id);
+        return;
+      }
+      // Find or append the child for the next byte.
+      link = &node.child;
+      while (*link && nodes[*link].c != *p) link = &nodes[*link].sibling;
+    }
+  }
+
+  constexpr void assert_room() {
+    // Not constexpr-evaluable, so overflowing the node pool is a compile error.
+    if (node_count >= max_nodes) throw "PunctTrie node pool too small";
+  }
+
+  // End of the longest punctuator at text, or nullptr. Input must be
+  // NUL-terminated - no node matches a NUL, so the walk always stops there.
+  const char* match(const char* text, int& id) const {
+    const char* best = nullptr;
+    id = 0;
+
+    auto n = roots[uint8_t(*text)];
+    while (n) {
+      auto& node = nodes[n];
+      text++;
+      if (node.punct) {
+        best = text;
+        id = node.punct;
+      }
+      n = node.child;
+      while (n && nodes[n].c != *text) n = nodes[n].sibling;
+    }
+
+    return best;
+  }
+
+  Node    nodes[max_nodes];
+  int     node_count;
+  uint8_t roots[256];
+};
+
+inline constexpr PunctTrie punct_trie;
+
+//------------------------------------------------------------------------------
+// Longest-match punctuator, nullptr if none. Follows the C++11 rule that "<::"
+// lexes as "<" "::" unless the next byte is ':' or '>', so "vector<::foo>"
+// isn't read as a "<:" digraph.
+
+const char* scan_punct(const char* text);
+
+// Same, and sets id to the punctuator's id. Not an overload, so scan_punct
+// still names a single function for PROBE_MATCHER.
+const char* scan_punct_id(const char* text, int& id);
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,161 @@
+#include "parseroni/Scanners.h"
+
+#include "parseroni/Simd.h"
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\v' || c == '\f';
+}
+
+inline bool is_ws(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// '$' is a common extension, and any byte >= 0x80 is taken to be part of a
+// UTF-8 sequence.
+inline bool is_ident_start(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || uint8_t(c) >= 0x80;
+}
+
+inline bool is_ident(char c) {
+  return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+//------------------------------------------------------------------------------
+
+const char* skip_space_run(const char* text) {
+#if PARSERONI_SIMD
+  // '\v' and '\f' are adjacent, so the class is two compares and one range.
+  return simd_find(text, [](vec c) {
+    auto hit = vor(vor(veq(c, vset(' ')), veq(c, vset('\t'))), vrange(c, '\v', '\f'));
+    return veq(hit, vset(0));
+  });
+#else
+  while (is_space(*text)) text++;
+  return text;
+#endif
+}
+
+const char* skip_ws_run(const char* text) {
+#if PARSERONI_SIMD
+  return simd_find(text, [](vec c) {
+    auto hit = vor(veq(c, vset(' ')), vrange(c, '\t', '\r'));
+    return veq(hit, vset(0));
+  });
+#else
+  while (is_ws(*text)) text++;
+  return text;
+#endif
+}
+
+const char* skip_ident_run(const char* text) {
+#if PARSERONI_SIMD
+  // Setting bit 5 folds upper case onto lower case. vrange() is unsigned, so
+  // 0x80-0xFF is one more range.
+  return simd_find(text, [](vec c) {
+    auto alpha = vrange(vor(c, vset(0x20)), 'a', 'z');
+    auto punct = vor(veq(c, vset('_')), veq(c, vset('$')));
+    auto hit = vor(vor(alpha, vrange(c, '0', '9')), vor(punct, vrange(c, char(0x80), char(0xFF))));
+    return veq(hit, vset(0));
+  });
+#else
+  while (is_ident(*text)) text++;
+  return text;
+#endif
+}
+
+const char* find_quote_end(const char* text, char quote) {
+#if PARSERONI_SIMD
+  return simd_find(text, [quote](vec c) {
+    auto a = vor(veq(c, vset(quote)), veq(c, vset('\\')));
+    auto b = vor(veq(c, vset('\n')),   veq(c, vset(0)));
+    return vor(a, b);
+  });
+#else
+  while (*text && *text != quote && *text != '\\' && *text != '\n') text++;
+  return text;
+#endif
+}
+
+const char* find_star(const char* text) {
+#if PARSERONI_SIMD
+  return simd_find(text, [](vec c) {
+    return vor(veq(c, vset('*')), veq(c, vset(0)));
+  });
+#else
+  while (*text && *text != '*') text++;
+  return text;
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+const char* scan_space(const char* text) {
+  if (!is_space(*text)) return nullptr;
+  return skip_space_run(text + 1);
+}
+
+const char* scan_ws(const char* text) {
+  if (!is_ws(*text)) return nullptr;
+  return skip_ws_run(text + 1);
+}
+
+const char* scan_identifier(const char* text) {
+  if (!is_ident_start(*text)) return nullptr;
+  return skip_ident_run(text + 1);
+}
+
+//------------------------------------------------------------------------------
+
+static const char* skip_encoding_prefix(const char* text) {
+  if (text[0] == 'u' && text[1] == '8') return text + 2;
+  if (text[0] == 'u' || text[0] == 'U' || text[0] == 'L') return text + 1;
+  return text;
+}
+
+static const char* scan_quoted(const char* text, char quote) {
+  text = skip_encoding_prefix(text);
+  if (*text != quote) return nullptr;
+  text++;
+
+  while (1) {
+    text = find_quote_end(text, quote);
+    if (*text == quote) {
+      return text + 1;
+    }
+    else if (*text == '\\' && text[1]) {
+      // Escapes (including escaped newlines) are at least two bytes, anything
+      // longer like \x1234 is plain body text as far as finding the end goes.
+      text += (text[1] == '\r' && text[2] == '\n') ? 3 : 2;
+    }
+    else {
+      // Newline, NUL, or a backslash right before the NUL.
+      return nullptr;
+    }
+  }
+}
+
+const char* scan_string(const char* text) {
+  return scan_quoted(text, '"');
+}
+
+const char* scan_char_literal(const char* text) {
+  return scan_quoted(text, '\'');
+}
+
+const char* scan_multiline_comment(const char* text) {
+  if (text[0] != '/' || text[1] != '*') return nullptr;
+  text += 2;
+
+  while (1) {
+    text = find_star(text);
+    if (*text == 0) return nullptr;
+    if (text[1] == '/') return text + 2;
+    text++;
+  }
+}
+
+//------------------------------------------------------------------------------
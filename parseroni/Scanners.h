@@ -0,0 +1,39 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Vectorized run scanners. All of these expect NUL-terminated input (which
+// Parser::load guarantees) and never read past the aligned block holding the
+// terminator.
+
+// End of the run of ' ', '\t', '\v', '\f' starting at text.
+const char* skip_space_run(const char* text);
+
+// End of the run of isspace() bytes starting at text.
+const char* skip_ws_run(const char* text);
+
+// End of the run of [A-Za-z0-9_$] and bytes >= 0x80 starting at text.
+const char* skip_ident_run(const char* text);
+
+// First quote, backslash, newline or NUL at or after text. The body of a
+// string or char literal is everything up to that point.
+const char* find_quote_end(const char* text, char quote);
+
+// First '*' or NUL at or after text.
+const char* find_star(const char* text);
+
+//------------------------------------------------------------------------------
+// The same kernels with the usual matcher signature - nullptr if nothing
+// matched - so they can drop in anywhere a match_* function goes.
+
+const char* scan_space(const char* text);
+const char* scan_ws(const char* text);
+const char* scan_identifier(const char* text);
+
+// String and char literals with an optional u8/u/U/L prefix. A backslash
+// consumes the byte after it, an unescaped newline means no match.
+const char* scan_string(const char* text);
+const char* scan_char_literal(const char* text);
+
+const char* scan_multiline_comment(const char* text);
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// Minimal wrapper over the vector instructions the scanners need, so each
+// kernel is written once. Picks AVX2 (32 bytes/step) when the compiler is
+// allowed to use it, otherwise SSE2 (16 bytes/step, always there on x86-64).
+// With neither, PARSERONI_SIMD is 0 and callers use their scalar loops.
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+#define PARSERONI_SIMD 1
+
+typedef __m256i vec;
+static const int vec_bytes = 32;
+static const uint32_t vec_lanes = 0xFFFFFFFF;
+
+inline vec      vload(const char* p)    { return _mm256_load_si256((const __m256i*)p); }
+inline vec      vset(char c)            { return _mm256_set1_epi8(c); }
+inline vec      veq(vec a, vec b)       { return _mm256_cmpeq_epi8(a, b); }
+inline vec      vor(vec a, vec b)       { return _mm256_or_si256(a, b); }
+inline vec      vand(vec a, vec b)      { return _mm256_and_si256(a, b); }
+inline vec      vsub(vec a, vec b)      { return _mm256_sub_epi8(a, b); }
+inline vec      vmin(vec a, vec b)      { return _mm256_min_epu8(a, b); }
+inline uint32_t vmask(vec a)            { return uint32_t(_mm256_movemask_epi8(a)); }
+
+#elif defined(__SSE2__)
+
+#include <emmintrin.h>
+#define PARSERONI_SIMD 1
+
+typedef __m128i vec;
+static const int vec_bytes = 16;
+static const uint32_t vec_lanes = 0xFFFF;
+
+inline vec      vload(const char* p)    { return _mm_load_si128((const __m128i*)p); }
+inline vec      vset(char c)            { return _mm_set1_epi8(c); }
+inline vec      veq(vec a, vec b)       { return _mm_cmpeq_epi8(a, b); }
+inline vec      vor(vec a, vec b)       { return _mm_or_si128(a, b); }
+inline vec      vand(vec a, vec b)      { return _mm_and_si128(a, b); }
+inline vec      vsub(vec a, vec b)      { return _mm_sub_epi8(a, b); }
+inline vec      vmin(vec a, vec b)      { return _mm_min_epu8(a, b); }
+inline uint32_t vmask(vec a)            { return uint32_t(_mm_movemask_epi8(a)); }
+
+#else
+
+#define PARSERONI_SIMD 0
+
+#endif
+
+//------------------------------------------------------------------------------
+
+#if PARSERONI_SIMD
+
+// Lanes where lo <= c <= hi, unsigned.
+inline vec vrange(vec c, char lo, char hi) {
+  auto d = vsub(c, vset(lo));
+  return veq(vmin(d, vset(char(hi - lo))), d);
+}
+
+// Returns the first byte at or after text whose lane is set in match(block).
+// match() must flag the NUL byte, which is what stops us at the sentinel.
+//
+// Loads are aligned, so a block never straddles a page boundary and we can't
+// fault by reading past the sentinel. Lanes before 'text' are masked off.
+template<typename F>
+__attribute__((no_sanitize_address))
+inline const char* simd_find(const char* text, F match) {
+  auto block = (const char*)(uintptr_t(text) & ~uintptr_t(vec_bytes - 1));
+  uint32_t hits = vmask(match(vload(block))) & (vec_lanes << (text - block));
+  while (!hits) {
+    block += vec_bytes;
+    hits = vmask(match(vload(block)));
+  }
+  return block + __builtin_ctz(hits);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,264 @@
+#include "parseroni/Stream.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// The scanners' aligned vector loads can run up to a vector past the sentinel,
+// so the buffer is aligned and padded by at least that much.
+
+static const size_t buf_align = 64;
+
+static char* alloc_buf(size_t size) {
+  size_t padded = (size + 1 + buf_align + buf_align - 1) & ~(buf_align - 1);
+  return (char*)aligned_alloc(buf_align, padded);
+}
+
+//------------------------------------------------------------------------------
+
+bool StreamReader::open(int fd, size_t window_size, size_t max_carry) {
+  close();
+
+  if (window_size == 0) window_size = 1;
+
+  this->fd = fd;
+  this->window_size = window_size;
+  this->max_carry = max_carry;
+
+  buf_cap = 2 * window_size;
+  buf = alloc_buf(buf_cap);
+  for (auto& b : blocks) b.data = (char*)malloc(window_size);
+
+  if (!buf || !blocks[0].data || !blocks[1].data) {
+    close();
+    return false;
+  }
+
+  buf[0] = 0;
+  data = buf;
+  stop = false;
+  reader = std::thread(&StreamReader::reader_main, this);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+void StreamReader::close() {
+  if (reader.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stop = true;
+    }
+    cv.notify_all();
+    reader.join();
+  }
+
+  free(buf);
+  for (auto& b : blocks) {
+    free(b.data);
+    b = Block();
+  }
+
+  fd = -1;
+  buf = nullptr;
+  buf_cap = 0;
+  next_block = 0;
+
+  data = nullptr;
+  size = 0;
+  offset = 0;
+  eof = false;
+  failed = false;
+}
+
+//------------------------------------------------------------------------------
+// Fills the two blocks alternately, each as full as the fd will go, until EOF.
+
+void StreamReader::reader_main() {
+  for (int i = 0;; i ^= 1) {
+    auto& b = blocks[i];
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      cv.wait(guard, [&] { return stop || !b.full; });
+      if (stop) return;
+    }
+
+    // Pipes hand back whatever's there, so keep going until the block's full.
+    size_t got = 0;
+    bool last = false;
+    bool error = false;
+    while (got < window_size) {
+      auto n = ::read(fd, b.data + got, window_size - got);
+      if (n > 0) {
+        got += size_t(n);
+      }
+      else if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      else {
+        last = true;
+        error = n < 0;
+        break;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      b.size  = got;
+      b.last  = last;
+      b.error = error;
+      b.full  = true;
+    }
+    cv.notify_all();
+
+    if (last) return;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void StreamReader::reserve(size_t want) {
+  if (want <= buf_cap) return;
+
+  size_t cap = std::max(want, 2 * buf_cap);
+  auto new_buf = alloc_buf(cap);
+  memcpy(new_buf, buf, size);
+  free(buf);
+  buf = new_buf;
+  buf_cap = cap;
+}
+
+bool StreamReader::take_block(size_t& appended) {
+  auto& b = blocks[next_block];
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [&] { return b.full; });
+  }
+
+  reserve(size + b.size);
+  memcpy(buf + size, b.data, b.size);
+  size += b.size;
+  appended += b.size;
+  eof = b.last;
+  failed = b.error;
+
+  // The reader can refill the block as soon as it's marked empty.
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    b.full = false;
+  }
+  cv.notify_all();
+
+  next_block ^= 1;
+  return !eof;
+}
+
+//------------------------------------------------------------------------------
+
+bool StreamReader::advance(size_t used) {
+  if (!buf) return false;
+  assert(used <= size);
+
+  memmove(buf, buf + used, size - used);
+  size -= used;
+  offset += used;
+  data = buf;
+  buf[size] = 0;
+
+  if (eof || failed) return false;
+
+  if (size > max_carry) {
+    failed = true;
+    return false;
+  }
+
+  size_t carried = size;
+  size_t appended = 0;
+  while (take_block(appended) && appended < std::max(carried, size_t(1))) {}
+
+  data = buf;
+  buf[size] = 0;
+  return !failed;
+}
+
+//------------------------------------------------------------------------------
+
+bool StreamLexer::open(int fd, size_t window_size, size_t max_token) {
+  close();
+  return reader.open(fd, window_size, max_token);
+}
+
+void StreamLexer::close() {
+  reader.close();
+  tokens.clear();
+  text = nullptr;
+  offset = 0;
+  bytes = 0;
+  token_count = 0;
+  error_offset = 0;
+  used = 0;
+  done = false;
+  lex_failed = false;
+}
+
+//------------------------------------------------------------------------------
+
+bool StreamLexer::next() {
+  tokens.clear();
+
+  while (!done) {
+    if (!reader.advance(used)) {
+      if (reader.failed) error_offset = reader.offset;
+      done = true;
+      break;
+    }
+
+    text = reader.data;
+    offset = reader.offset;
+
+    auto size = reader.size;
+    assert(size <= UINT32_MAX);
+    auto stop = lex_range(text, 0, uint32_t(size), tokens);
+
+    if (reader.eof) {
+      done = true;
+      if (stop < size) {
+        lex_failed = true;
+        error_offset = offset + stop;
+      }
+    }
+    else {
+      // Hold back anything more text could change - tokens near the end, and
+      // everything from the first token that a longer comment or literal
+      // might have swallowed.
+      size_t safe = size > stream_lookahead ? size - stream_lookahead : 0;
+      size_t keep = tokens.size();
+      while (keep && tokens.ends[keep - 1] > safe) keep--;
+      for (size_t i = 0; i < keep; i++) {
+        auto type = LexType(tokens.types[i]);
+        if (type != LEX_PUNCT && type != LEX_IDENTIFIER) continue;
+        if (lex_is_fallback(text + tokens.begin_of(i), text + tokens.end_of(i), type)) {
+          keep = i;
+          break;
+        }
+      }
+      tokens.types.resize(keep);
+      tokens.ends.resize(keep);
+    }
+
+    used = tokens.size() ? tokens.ends.back() : 0;
+    if (tokens.size()) {
+      bytes += used;
+      token_count += tokens.size();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "parseroni/Lexer.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+
+//------------------------------------------------------------------------------
+// No matcher looks more than a few bytes past the end of the token it returns
+// ("..", "%:%", "1e+"), so a token that ends at least this far before the end
+// of what we've read comes out the same whatever is read next. Anything closer
+// to the end, or anything that failed, gets lexed again with more text behind
+// it.
+
+static const size_t stream_lookahead = 8;
+
+//------------------------------------------------------------------------------
+// Reads a file descriptor - a pipe, a socket, cpp -E output - a window at a
+// time into one buffer, keeping whatever the caller hasn't used yet at the
+// front. A background thread reads the next window while the caller works on
+// this one.
+//
+// Memory is the window, the carried tail and one read-ahead window. The tail
+// is normally a partial token, so it's bounded by the longest token - anything
+// past max_carry is treated as an error rather than buffered.
+
+struct StreamReader {
+  StreamReader() {}
+  ~StreamReader() { close(); }
+
+  StreamReader(const StreamReader&) = delete;
+  StreamReader& operator=(const StreamReader&) = delete;
+
+  // Doesn't take ownership of fd.
+  bool open(int fd, size_t window_size = 1 << 20, size_t max_carry = 64 << 20);
+
+  // Waits for a read in progress to come back, so closing a pipe that's
+  // still being written to blocks until the writer sends something or quits.
+  void close();
+
+  // Drops the first 'used' bytes of data and appends at least a window, and
+  // at least as much as is left over, from the stream - so a token that keeps
+  // running off the end doubles the buffer each time instead of re-scanning
+  // it a window at a time. Returns false once the stream is used up or on an
+  // error.
+  bool advance(size_t used);
+
+  // Always followed by a zero byte.
+  const char* data = nullptr;
+  size_t   size = 0;
+  uint64_t offset = 0;   // stream offset of data[0]
+  bool     eof = false;  // no more data will come after data[size]
+  bool     failed = false;
+
+private:
+
+  struct Block {
+    char*  data = nullptr;
+    size_t size = 0;
+    bool   full = false;
+    bool   last = false;  // EOF or a read error after this block
+    bool   error = false;
+  };
+
+  void reader_main();
+  bool take_block(size_t& appended);
+  void reserve(size_t want);
+
+  int    fd = -1;
+  size_t window_size = 0;
+  size_t max_carry = 0;
+
+  char*  buf = nullptr;
+  size_t buf_cap = 0;
+
+  // Two blocks in flight - one being read, one waiting for advance().
+  Block  blocks[2];
+  int    next_block = 0;
+
+  std::thread reader;
+  std::mutex lock;
+  std::condition_variable cv;
+  bool stop = false;
+};
+
+//------------------------------------------------------------------------------
+// Lexes a stream in bounded memory. Each next() produces the tokens that are
+// complete in the current window; a token that runs off the end of a window
+// is held back and comes out whole in the next one. The concatenated output is
+// exactly what lex_all() would produce for the whole stream.
+//
+//   StreamLexer lexer;
+//   lexer.open(fd);
+//   while (lexer.next()) {
+//     for (size_t i = 0; i < lexer.tokens.size(); i++) {
+//       cspan s = lexer.tokens.span(lexer.text, i);
+//       ...
+//     }
+//   }
+//   if (lexer.failed()) ...
+
+struct StreamLexer {
+  // Tokens longer than max_token are an error.
+  bool open(int fd, size_t window_size = 1 << 20, size_t max_token = 64 << 20);
+  void close();
+
+  // False once there's nothing left. Token offsets are relative to 'text',
+  // which is only valid until the next call.
+  bool next();
+
+  bool failed() const { return lex_failed || reader.failed; }
+
+  const char* text = nullptr;
+  uint64_t    offset = 0;     // stream offset of text[0]
+  TokenBuffer tokens;
+
+  uint64_t bytes = 0;         // total lexed so far
+  uint64_t token_count = 0;
+  uint64_t error_offset = 0;  // stream offset lexing stopped at, if failed()
+
+private:
+  StreamReader reader;
+  size_t used = 0;
+  bool   done = false;
+  bool   lex_failed = false;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,117 @@
+#include "parseroni/TokenCache.h"
+
+#include <atomic>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const uint32_t token_cache_magic = 0x4B4F5450; // "PTOK"
+
+static size_t ends_offset(size_t count) {
+  return (sizeof(TokenCacheHeader) + count + 3) & ~size_t(3);
+}
+
+//------------------------------------------------------------------------------
+
+void CachedTokens::to_buffer(TokenBuffer& out) const {
+  out.types.assign(types, types + count);
+  out.ends.assign(ends, ends + count);
+}
+
+//------------------------------------------------------------------------------
+
+bool TokenCache::open(const std::string& dir) {
+  std::error_code err;
+  fs::create_directories(dir, err);
+  if (!fs::is_directory(dir, err)) {
+    this->dir.clear();
+    return false;
+  }
+  this->dir = dir;
+  return true;
+}
+
+std::string TokenCache::entry_path(uint64_t hash) const {
+  char name[40];
+  snprintf(name, sizeof(name), "/%02x/%016llx.tok", unsigned(hash >> 56), (unsigned long long)hash);
+  return dir + name;
+}
+
+//------------------------------------------------------------------------------
+// Anything that doesn't look exactly right - short file, other version, a
+// different size under the same hash - is a miss, and gets overwritten by
+// the next store.
+
+bool TokenCache::lookup(uint64_t hash, size_t source_size, CachedTokens& out) const {
+  out.count = 0;
+  if (!is_open() || !out.file.open(entry_path(hash).c_str())) return false;
+
+  auto data = out.file.data;
+  auto size = out.file.size;
+  if (size < sizeof(TokenCacheHeader)) return false;
+
+  TokenCacheHeader header;
+  memcpy(&header, data, sizeof(header));
+
+  if (header.magic != token_cache_magic ||
+      header.version != token_cache_version ||
+      header.content_hash != hash ||
+      header.source_size != source_size ||
+      size != ends_offset(header.token_count) + header.token_count * sizeof(uint32_t)) {
+    out.file.close();
+    return false;
+  }
+
+  out.types = (const uint8_t*)(data + sizeof(TokenCacheHeader));
+  out.ends  = (const uint32_t*)(data + ends_offset(header.token_count));
+  out.count = header.token_count;
+  out.ok = header.ok;
+  out.error_offset = header.error_offset;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool TokenCache::store(uint64_t hash, size_t source_size, const TokenBuffer& tokens,
+                       bool ok, uint32_t error_offset) const {
+  if (!is_open()) return false;
+
+  size_t count = tokens.size();
+
+  TokenCacheHeader header = {};
+  header.magic = token_cache_magic;
+  header.version = token_cache_version;
+  header.content_hash = hash;
+  header.source_size = source_size;
+  header.token_count = uint32_t(count);
+  header.ok = ok;
+  header.error_offset = error_offset;
+
+  std::string blob(ends_offset(count) + count * sizeof(uint32_t), 0);
+  memcpy(&blob[0], &header, sizeof(header));
+  memcpy(&blob[sizeof(header)], tokens.types.data(), count);
+  memcpy(&blob[ends_offset(count)], tokens.ends.data(), count * sizeof(uint32_t));
+
+  auto path = entry_path(hash);
+  std::error_code err;
+  fs::create_directories(fs::path(path).parent_path(), err);
+
+  static std::atomic<uint64_t> serial = 0;
+  auto temp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(serial++);
+
+  auto f = fopen(temp.c_str(), "wb");
+  if (!f) return false;
+  bool written = fwrite(blob.data(), 1, blob.size(), f) == blob.size();
+  written &= fclose(f) == 0;
+
+  if (!written || rename(temp.c_str(), path.c_str()) != 0) {
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
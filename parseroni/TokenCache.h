@@ -0,0 +1,86 @@
+#pragma once
+
+#include "parseroni/Lexer.h"
+#include "parseroni/MappedFile.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+// On-disk cache of lexer output, keyed by the hash64() of the source bytes -
+// not the path or the mtime, so a file that's touched, copied or checked out
+// again still hits, and two copies of the same header share one entry.
+//
+// One entry per file, laid out so it can be mapped and used in place:
+//
+//   TokenCacheHeader
+//   uint8_t  types[token_count]
+//   (zero padding to a multiple of 4)
+//   uint32_t ends[token_count]
+//
+// Everything is host byte order - the cache is a local scratch directory, not
+// something to ship between machines.
+
+// Bump whenever the lexer's output for some input changes, so stale entries
+// are ignored instead of trusted.
+static const uint32_t token_cache_version = 1;
+
+struct TokenCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t content_hash;
+  uint64_t source_size;
+  uint32_t token_count;
+  uint32_t ok;            // did the whole file lex
+  uint32_t error_offset;  // where lexing stopped, if !ok
+  uint32_t reserved;
+};
+
+//------------------------------------------------------------------------------
+// A cache entry mapped read-only. Same accessors as TokenBuffer.
+
+struct CachedTokens {
+  size_t size() const { return count; }
+
+  uint32_t begin_of(size_t i) const { return i ? ends[i - 1] : 0; }
+  uint32_t end_of(size_t i)   const { return ends[i]; }
+
+  cspan span(const char* base, size_t i) const {
+    return cspan(base + begin_of(i), base + end_of(i));
+  }
+
+  void to_buffer(TokenBuffer& out) const;
+
+  const uint8_t*  types = nullptr;
+  const uint32_t* ends = nullptr;
+  size_t   count = 0;
+  bool     ok = false;
+  uint32_t error_offset = 0;
+
+  MappedFile file;
+};
+
+//------------------------------------------------------------------------------
+// Entries live at <dir>/<first two hex digits>/<hash>.tok. Writes go to a
+// temporary file that's renamed into place, so any number of threads or
+// processes can share a cache directory and readers never see half an entry.
+
+struct TokenCache {
+  // Creates the directory if it's not there.
+  bool open(const std::string& dir);
+
+  bool is_open() const { return !dir.empty(); }
+
+  // Maps the entry for this content, if there's a valid one.
+  bool lookup(uint64_t hash, size_t source_size, CachedTokens& out) const;
+
+  bool store(uint64_t hash, size_t source_size, const TokenBuffer& tokens,
+             bool ok, uint32_t error_offset) const;
+
+  std::string entry_path(uint64_t hash) const;
+
+  std::string dir;
+};
+
+//------------------------------------------------------------------------------
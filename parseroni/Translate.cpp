@@ -0,0 +1,89 @@
+#include "parseroni/Translate.h"
+
+#include "parseroni/Simd.h"
+
+#include <algorithm>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+
+void SpliceMap::push(uint32_t offset, uint32_t removed) {
+  assert(at.empty() || offset >= at.back());
+
+  // Back-to-back splices collapse into one entry.
+  if (!at.empty() && at.back() == offset) {
+    shift.back() += removed;
+    return;
+  }
+
+  at.push_back(offset);
+  shift.push_back((shift.empty() ? 0 : shift.back()) + removed);
+}
+
+uint32_t SpliceMap::to_physical(uint32_t offset) const {
+  auto i = std::upper_bound(at.begin(), at.end(), offset) - at.begin();
+  return i ? offset + shift[i - 1] : offset;
+}
+
+uint32_t SpliceMap::to_physical_end(uint32_t offset) const {
+  auto i = std::lower_bound(at.begin(), at.end(), offset) - at.begin();
+  return i ? offset + shift[i - 1] : offset;
+}
+
+//------------------------------------------------------------------------------
+
+const char* find_splice_candidate(const char* text) {
+#if PARSERONI_SIMD
+  return simd_find(text, [](vec c) {
+    return vor(vor(veq(c, vset('\\')), veq(c, vset('\r'))), veq(c, vset(0)));
+  });
+#else
+  while (*text && *text != '\\' && *text != '\r') text++;
+  return text;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Plain text between candidates goes over in one append, so the cost is one
+// vector compare per block plus a little per splice.
+
+bool translate_source(const char* text, size_t size, std::string& out, SpliceMap& map) {
+  assert(size <= UINT32_MAX);
+  assert(text[size] == 0);
+
+  out.clear();
+  map.clear();
+
+  auto end = text + size;
+  auto copied = text;  // everything before this is in 'out'
+
+  for (auto c = find_splice_candidate(text); c < end; c = find_splice_candidate(c)) {
+    int removed = 0;
+    if (c[0] == '\\') {
+      if (c[1] == '\n') removed = 2;
+      else if (c[1] == '\r' && c[2] == '\n') removed = 3;
+    }
+    else if (c[0] == '\r') {
+      if (c[1] == '\n') removed = 1;
+    }
+
+    if (!removed) {
+      // A backslash that's not a splice, a lone CR, or a NUL inside the text.
+      c++;
+      continue;
+    }
+
+    if (map.empty()) out.reserve(size + 1);
+    out.append(copied, c);
+    c += removed;
+    copied = c;
+    map.push(uint32_t(out.size()), uint32_t(removed));
+  }
+
+  if (map.empty()) return false;
+
+  out.append(copied, end);
+  return true;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Translation phases 1 and 2 - CRLF becomes LF, and every backslash-newline is
+// deleted so the lines either side of it join up. Run once up front, the
+// matchers see the logical text and never have to think about splices in the
+// middle of an identifier or a "*/".
+//
+// SpliceMap takes logical offsets back to offsets in the original text. It
+// only stores the places something was removed, so a file with no splices
+// and LF endings costs nothing.
+
+struct SpliceMap {
+  void clear() {
+    at.clear();
+    shift.clear();
+  }
+
+  bool empty() const { return at.empty(); }
+
+  void swap(SpliceMap& b) {
+    at.swap(b.at);
+    shift.swap(b.shift);
+  }
+
+  // Records 'removed' physical bytes dropped just before logical offset 'offset'.
+  // Offsets must not go backwards.
+  void push(uint32_t offset, uint32_t removed);
+
+  // Physical offset of the logical byte at 'offset'.
+  uint32_t to_physical(uint32_t offset) const;
+
+  // Physical offset for the end of a span that ends at logical 'offset' - a
+  // splice right after the span's last byte isn't part of the span.
+  uint32_t to_physical_end(uint32_t offset) const;
+
+  std::vector<uint32_t> at;     // logical offsets, increasing
+  std::vector<uint32_t> shift;  // physical - logical from at[i] onwards
+};
+
+// Translates text[0, size) into out and fills in map. text[size] must be zero.
+// If there's nothing to translate, out and map are left empty and false comes
+// back - the original text is already logical.
+bool translate_source(const char* text, size_t size, std::string& out, SpliceMap& map);
+
+// First '\\', '\r' or NUL at or after text.
+const char* find_splice_candidate(const char* text);
+
+//------------------------------------------------------------------------------
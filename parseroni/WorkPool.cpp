@@ -0,0 +1,104 @@
+#include "parseroni/WorkPool.h"
+
+static thread_local WorkPool* tls_pool = nullptr;
+static thread_local int tls_thread = -1;
+
+//------------------------------------------------------------------------------
+
+WorkPool::WorkPool(int thread_count) {
+  if (thread_count <= 0) thread_count = int(std::thread::hardware_concurrency());
+  if (thread_count <= 0) thread_count = 1;
+
+  for (int i = 0; i < thread_count; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (int i = 0; i < thread_count; i++) {
+    workers.emplace_back(&WorkPool::worker_main, this, i);
+  }
+}
+
+WorkPool::~WorkPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock);
+    stop = true;
+  }
+  sleep_cv.notify_all();
+  for (auto& w : workers) w.join();
+}
+
+//------------------------------------------------------------------------------
+
+int WorkPool::current_thread() {
+  return tls_thread;
+}
+
+//------------------------------------------------------------------------------
+
+void WorkPool::push(Task task) {
+  int thread = (tls_pool == this) ? tls_thread : int(next_queue++ % queues.size());
+
+  pending++;
+  {
+    auto& q = *queues[thread];
+    std::lock_guard<std::mutex> guard(q.lock);
+    q.tasks.push_back(std::move(task));
+  }
+  queued++;
+
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock);
+  }
+  sleep_cv.notify_one();
+}
+
+//------------------------------------------------------------------------------
+
+void WorkPool::wait() {
+  std::unique_lock<std::mutex> guard(done_lock);
+  done_cv.wait(guard, [this]() { return pending == 0; });
+}
+
+//------------------------------------------------------------------------------
+// Own queue first, then everyone else's starting from our neighbour so the
+// thieves don't all pile onto queue 0.
+
+bool WorkPool::pop(int thread, Task& out) {
+  int count = int(queues.size());
+  for (int i = 0; i < count; i++) {
+    auto& q = *queues[(thread + i) % count];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (!q.tasks.empty()) {
+      out = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+
+void WorkPool::worker_main(int thread) {
+  tls_pool = this;
+  tls_thread = thread;
+
+  while (1) {
+    Task task;
+    if (pop(thread, task)) {
+      task(thread);
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> guard(done_lock);
+        done_cv.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(sleep_lock);
+    sleep_cv.wait(guard, [this]() { return stop || queued > 0; });
+    if (stop) return;
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Fixed-size thread pool with one task queue per worker and stealing.
+//
+// Tasks pushed from outside the pool are dealt round-robin across the worker
+// queues in push order, tasks pushed from inside a task go on that worker's own
+// queue. Workers take from the front of their own queue and, when it runs dry,
+// steal from the front of the others. Both ends being the front means that if
+// the caller pushes its biggest jobs first, the biggest remaining job is
+// always the next one started - which is what keeps the tail short.
+
+class WorkPool {
+public:
+
+  using Task = std::function<void(int thread)>;
+
+  // thread_count <= 0 means one thread per core.
+  WorkPool(int thread_count = 0);
+  ~WorkPool();
+
+  WorkPool(const WorkPool&) = delete;
+  WorkPool& operator=(const WorkPool&) = delete;
+
+  void push(Task task);
+
+  // Blocks until every task, including tasks pushed by tasks, has finished.
+  void wait();
+
+  int thread_count() const { return int(workers.size()); }
+
+  // Index of the calling worker thread in its pool, or -1 outside a pool.
+  static int current_thread();
+
+private:
+
+  struct Queue {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  bool pop(int thread, Task& out);
+  void worker_main(int thread);
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<Queue>> queues;
+
+  std::atomic<int>    queued = 0;   // tasks sitting in queues
+  std::atomic<int>    pending = 0;  // tasks queued or running
+  std::atomic<size_t> next_queue = 0;
+  bool stop = false;
+
+  std::mutex sleep_lock;
+  std::condition_variable sleep_cv;
+
+  std::mutex done_lock;
+  std::condition_variable done_cv;
+};
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,710 @@
+#include "parseroni/Parser.h"
+
+#include "parseroni/Combinators.h"
+#include "parseroni/Hash.h"
+#include "parseroni/Lexer.h"
+#include "parseroni/LineIndex.h"
+#include "parseroni/MappedFile.h"
+#include "parseroni/Numbers.h"
+#include "parseroni/Operators.h"
+#include "parseroni/Punctuators.h"
+#include "parseroni/Scanners.h"
+#include "parseroni/Translate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// bin/parseroni_bench - throughput of the individual matchers, take_token and
+// the whole lexer over a fixed corpus.
+//
+//   parseroni_bench [--runs N] [--corpus file]... [--json out.json]
+//                   [--baseline old.json] [--threshold percent]
+//
+// With no --corpus, a synthetic corpus is generated from a fixed seed so runs
+// on different machines or different days see the same bytes. With
+// --baseline, any benchmark whose median MB/s dropped by more than the
+// threshold (default 5%) is reported and the exit code is 1.
+
+//------------------------------------------------------------------------------
+
+static double now_seconds() {
+  using namespace std::chrono;
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+//------------------------------------------------------------------------------
+
+struct Rng {
+  uint32_t next() {
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+  }
+  uint32_t operator()(uint32_t n) { return next() % n; }
+  uint32_t state = 12345;
+};
+
+// Roughly what our real inputs look like - declarations, register tables,
+// string tables, comments of all sizes, a few long generated identifiers.
+static std::string make_corpus(size_t size) {
+  Rng rng;
+  std::string out;
+  out.reserve(size + 4096);
+
+  const char* words[] = { "foo", "bar", "count", "index", "buffer", "REG_CTRL", "value", "p", "i", "x" };
+  const char* fragments[] = { "abc", "defgh ", "\\n", "\\\"", "xyz", " " };
+  const char* ops[]   = { " + ", " - ", " * ", " << ", " >> ", " & ", " | ", " == ", " != ", " += ", "->" };
+  char buf[256];
+
+  auto word = [&]() { return words[rng(10)]; };
+
+  while (out.size() < size) {
+    switch (rng(8)) {
+      case 0:
+        snprintf(buf, sizeof(buf), "#include <%s/%s_%u.h>\n", word(), word(), rng(1000));
+        out += buf;
+        break;
+      case 1:
+        out += "/*\n";
+        for (int i = rng(20); i >= 0; i--) out += " * Licensed under the something or other license, see LICENSE for details.\n";
+        out += " */\n";
+        break;
+      case 2:
+        snprintf(buf, sizeof(buf), "static const unsigned int %s_table_%u[] = {\n", word(), rng(1000));
+        out += buf;
+        for (int i = rng(30); i >= 0; i--) {
+          snprintf(buf, sizeof(buf), "  0x%08X, %u, 0%o, %u.%ue%u,\n", rng(~0u), rng(100000), rng(4096), rng(100), rng(1000), rng(20));
+          out += buf;
+        }
+        out += "};\n";
+        break;
+      case 3:
+        out += "const char* strings[] = {\n";
+        for (int i = rng(20); i >= 0; i--) {
+          out += "  \"";
+          for (int j = rng(20); j >= 0; j--) out += fragments[rng(6)];
+          out += "\",\n";
+        }
+        out += "};\n";
+        break;
+      case 4:
+        snprintf(buf, sizeof(buf), "  if (%s_%s%s%s) { %s%s%u; } // %s\n", word(), word(), ops[rng(11)], word(), word(), ops[rng(11)], rng(100), word());
+        out += buf;
+        break;
+      case 5:
+        snprintf(buf, sizeof(buf), "        %s = %s(%s, '%c', %s);\n", word(), word(), word(), 'a' + rng(26), word());
+        out += buf;
+        break;
+      case 6:
+        snprintf(buf, sizeof(buf), "GENERATED_REGISTER_BLOCK_%u_FIELD_%s_%s_MASK_AND_SHIFT_VALUE_%u\n", rng(100), word(), word(), rng(100));
+        out += buf;
+        break;
+      default:
+        snprintf(buf, sizeof(buf), "\tfloat %s = %u.%uf * %s->%s[%u];\n", word(), rng(100), rng(100), word(), word(), rng(16));
+        out += buf;
+        break;
+    }
+  }
+
+  return out;
+}
+
+//------------------------------------------------------------------------------
+
+struct BenchResult {
+  std::string name;
+  double mb_per_sec = 0;   // median over runs
+  double ns_per_token = 0; // median over runs
+  double stddev_pct = 0;   // of MB/s, relative to the median
+  size_t bytes = 0;        // per run
+  size_t tokens = 0;       // per run
+};
+
+// Runs 'body' 'runs' times. body returns how many tokens it processed and
+// adds the bytes it covered to 'bytes'.
+template<typename F>
+static BenchResult bench(const char* name, int runs, F&& body) {
+  std::vector<double> mbps, nspt;
+  BenchResult r;
+  r.name = name;
+
+  for (int i = 0; i < runs; i++) {
+    size_t bytes = 0;
+    double start = now_seconds();
+    size_t tokens = body(bytes);
+    double elapsed = now_seconds() - start;
+    if (elapsed <= 0) elapsed = 1e-9;
+
+    mbps.push_back(bytes / elapsed / (1024.0 * 1024.0));
+    nspt.push_back(tokens ? elapsed * 1e9 / tokens : 0);
+    r.bytes = bytes;
+    r.tokens = tokens;
+  }
+
+  std::sort(mbps.begin(), mbps.end());
+  std::sort(nspt.begin(), nspt.end());
+  r.mb_per_sec   = mbps[mbps.size() / 2];
+  r.ns_per_token = nspt[nspt.size() / 2];
+
+  double mean = 0, var = 0;
+  for (auto x : mbps) mean += x;
+  mean /= mbps.size();
+  for (auto x : mbps) var += (x - mean) * (x - mean);
+  var /= mbps.size();
+  r.stddev_pct = r.mb_per_sec > 0 ? 100.0 * sqrt(var) / r.mb_per_sec : 0;
+
+  printf("%-28s %10.1f MB/s %8.2f ns/token  +-%5.1f%%  (%zu tokens)\n",
+         r.name.c_str(), r.mb_per_sec, r.ns_per_token, r.stddev_pct, r.tokens);
+  return r;
+}
+
+//------------------------------------------------------------------------------
+
+static bool write_json(const char* path, const std::vector<BenchResult>& results, size_t corpus_bytes) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+
+  fprintf(f, "{\n  \"corpus_bytes\": %zu,\n  \"benchmarks\": [\n", corpus_bytes);
+  for (size_t i = 0; i < results.size(); i++) {
+    auto& r = results[i];
+    fprintf(f, "    {\"name\": \"%s\", \"mb_per_sec\": %.3f, \"ns_per_token\": %.3f, \"stddev_pct\": %.3f, \"bytes\": %zu, \"tokens\": %zu}%s\n",
+            r.name.c_str(), r.mb_per_sec, r.ns_per_token, r.stddev_pct, r.bytes, r.tokens,
+            i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  return true;
+}
+
+// Reads back what write_json wrote - one benchmark object per line.
+static bool read_json(const char* path, std::vector<BenchResult>& results) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    auto name = strstr(line, "\"name\": \"");
+    auto mbps = strstr(line, "\"mb_per_sec\": ");
+    if (!name || !mbps) continue;
+
+    name += strlen("\"name\": \"");
+    auto name_end = strchr(name, '"');
+    if (!name_end) continue;
+
+    BenchResult r;
+    r.name.assign(name, name_end);
+    r.mb_per_sec = atof(mbps + strlen("\"mb_per_sec\": "));
+    results.push_back(r);
+  }
+
+  fclose(f);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+struct MatcherEntry {
+  const char* name;
+  match_fn    match;
+  LexType     type;
+};
+
+static const MatcherEntry matchers[] = {
+  { "match_space",             match_space,             LEX_SPACE },
+  { "scan_space",              scan_space,              LEX_SPACE },
+  { "match_newline",           match_newline,           LEX_NEWLINE },
+  { "match_identifier",        match_identifier,        LEX_IDENTIFIER },
+  { "scan_identifier",         scan_identifier,         LEX_IDENTIFIER },
+  { "match_int",               match_int,               LEX_INT },
+  { "match_float",             match_float,             LEX_FLOAT },
+  { "scan_number(int)",        scan_number,             LEX_INT },
+  { "scan_number(float)",      scan_number,             LEX_FLOAT },
+  { "match_string",            match_string,            LEX_STRING },
+  { "scan_string",             scan_string,             LEX_STRING },
+  { "match_char_literal",      match_char_literal,      LEX_CHAR_LITERAL },
+  { "scan_char_literal",       scan_char_literal,       LEX_CHAR_LITERAL },
+  { "match_oneline_comment",   match_oneline_comment,   LEX_COMMENT1 },
+  { "match_multiline_comment", match_multiline_comment, LEX_COMMENT2 },
+  { "scan_multiline_comment",  scan_multiline_comment,  LEX_COMMENT2 },
+  { "match_preproc",           match_preproc,           LEX_PREPROC },
+  { "match_punct",             match_punct,             LEX_PUNCT },
+  { "scan_punct",              scan_punct,              LEX_PUNCT },
+};
+
+//------------------------------------------------------------------------------
+// Expression-dense input - register masks, bit twiddling, the kind of thing
+// macros expand to. 'starts' gets the offset of each expression.
+
+static void make_expression(Rng& rng, std::string& out, int depth) {
+  const char* atoms[] = { "x", "count", "REG_CTRL", "mask", "0x1F", "3", "p->flags", "buf[i]", "f(a, b)", "1.5f" };
+  const char* binary[] = { " + ", " - ", " * ", " / ", " << ", " >> ", " & ", " | ", " ^ ",
+                           " == ", " != ", " < ", " >= ", " && ", " || " };
+
+  if (depth == 0 || rng(4) == 0) {
+    out += atoms[rng(10)];
+    return;
+  }
+
+  switch (rng(8)) {
+    case 0:
+      out += "(";
+      make_expression(rng, out, depth - 1);
+      out += ")";
+      break;
+    case 1:
+      out += "~";
+      make_expression(rng, out, depth - 1);
+      break;
+    case 2:
+      make_expression(rng, out, depth - 1);
+      out += " ? ";
+      make_expression(rng, out, depth - 1);
+      out += " : ";
+      make_expression(rng, out, depth - 1);
+      break;
+    default:
+      make_expression(rng, out, depth - 1);
+      out += binary[rng(15)];
+      make_expression(rng, out, depth - 1);
+      break;
+  }
+}
+
+static std::string make_expressions(size_t size, std::vector<uint32_t>& starts) {
+  Rng rng;
+  std::string out;
+  const char* targets[] = { "x = ", "flags |= ", "*p = ", "v[n] += ", "" };
+
+  while (out.size() < size) {
+    starts.push_back(uint32_t(out.size()));
+    out += targets[rng(5)];
+    make_expression(rng, out, 6);
+    out += ";\n";
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------
+// The same grammar one rule per precedence level, the way the BNF spells it
+// out - every operand goes down through all the levels, and every level scans
+// for its own operators. Builds the same nodes as take_expression(), so the
+// difference is just the shape of the parse.
+
+template<typename N>
+static PExpression* naive_node(Parser& p, PExpression* lhs, cspan op, PExpression* rhs) {
+  auto node = p.arena.create<N>();
+  node->lhs = lhs;
+  node->op = p.arena.create<PToken>();
+  node->op->span = op;
+  node->rhs = rhs;
+  node->span = cspan(lhs->span.begin, rhs->span.end);
+  return node;
+}
+
+static PExpression* naive_expression(Parser& p, int level) {
+  if (level > PREC_MULTIPLICATIVE) return p.take_unary_expression();
+
+  auto lhs = naive_expression(p, level + 1);
+  if (!lhs) return nullptr;
+
+  while (true) {
+    auto last = p.cursor;
+    p.skip_gap();
+
+    int id;
+    auto end = scan_punct_id(p.cursor, id);
+    auto& op = operator_table.binary[id];
+    if (op.kind == OP_NONE || op.prec != level) {
+      p.cursor = last;
+      return lhs;
+    }
+    auto op_span = *p.take_span(end);
+
+    if (op.kind == OP_CONDITIONAL) {
+      auto consequence = naive_expression(p, PREC_COMMA);
+      p.skip_gap();
+      auto colon = p.take_punct(punct_id(":"));
+      auto alternative = (consequence && colon) ? naive_expression(p, level) : nullptr;
+      if (!alternative) {
+        p.cursor = last;
+        return lhs;
+      }
+      auto node = p.arena.create<PConditionalExpression>();
+      node->condition = lhs;
+      node->lit_question = p.arena.create<PToken>();
+      node->lit_question->span = op_span;
+      node->consequence = consequence;
+      node->lit_colon = p.arena.create<PToken>();
+      node->lit_colon->span = *colon;
+      node->alternative = alternative;
+      node->span = cspan(lhs->span.begin, alternative->span.end);
+      return node;
+    }
+
+    bool assign = op.kind == OP_ASSIGN;
+    auto rhs = naive_expression(p, assign ? level : level + 1);
+    if (!rhs) {
+      p.cursor = last;
+      return lhs;
+    }
+
+    if (assign) return naive_node<PAssignmentExpression>(p, lhs, op_span, rhs);
+    lhs = naive_node<PBinaryExpression>(p, lhs, op_span, rhs);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+  int runs = 10;
+  double threshold = 5.0;
+  const char* json_path = nullptr;
+  const char* baseline_path = nullptr;
+  std::vector<const char*> corpus_paths;
+
+  for (int i = 1; i < argc; i++) {
+    auto arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if      (!strcmp(arg, "--runs")      && has_value) runs = atoi(argv[++i]);
+    else if (!strcmp(arg, "--json")      && has_value) json_path = argv[++i];
+    else if (!strcmp(arg, "--baseline")  && has_value) baseline_path = argv[++i];
+    else if (!strcmp(arg, "--threshold") && has_value) threshold = atof(argv[++i]);
+    else if (!strcmp(arg, "--corpus")    && has_value) corpus_paths.push_back(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--runs N] [--corpus file]... [--json out.json] [--baseline old.json] [--threshold percent]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (runs < 1) runs = 1;
+
+  //----------------------------------------
+
+  std::string corpus;
+  if (corpus_paths.empty()) {
+    corpus = make_corpus(4 * 1024 * 1024);
+  }
+  else {
+    for (auto path : corpus_paths) {
+      MappedFile f;
+      if (!f.open(path)) {
+        fprintf(stderr, "could not open %s\n", path);
+        return 2;
+      }
+      corpus.append(f.data, f.size);
+      corpus += "\n";
+    }
+  }
+
+  const char* text = corpus.c_str();
+  size_t size = corpus.size();
+
+  // Token positions, so each matcher only gets run where it's supposed to match.
+  TokenBuffer tokens;
+  if (!lex_all(text, size, tokens)) {
+    fprintf(stderr, "corpus doesn't lex cleanly, stopped at offset %u\n", tokens.begin_of(tokens.size()));
+    return 2;
+  }
+
+  printf("corpus %zu bytes, %zu tokens, %d runs\n\n", size, tokens.size(), runs);
+
+  std::vector<BenchResult> results;
+
+  //----------------------------------------
+
+  for (auto& m : matchers) {
+    std::vector<uint32_t> starts;
+    for (size_t i = 0; i < tokens.size(); i++) {
+      auto type = LexType(tokens.types[i]);
+      // Keywords are identifiers as far as the matchers are concerned.
+      if (type == LEX_KEYWORD) type = LEX_IDENTIFIER;
+      if (type == m.type) starts.push_back(tokens.begin_of(i));
+    }
+    if (starts.empty()) continue;
+
+    results.push_back(bench(m.name, runs, [&](size_t& bytes) {
+      for (auto s : starts) {
+        if (auto end = m.match(text + s)) bytes += end - (text + s);
+      }
+      return starts.size();
+    }));
+  }
+
+  //----------------------------------------
+
+  // Keyword lookup over every identifier-shaped token, perfect hash vs trying
+  // each keyword in turn the way the old take_lit lists did.
+  std::vector<cspan> words;
+  for (size_t i = 0; i < tokens.size(); i++) {
+    if (tokens.types[i] == LEX_IDENTIFIER || tokens.types[i] == LEX_KEYWORD) {
+      words.push_back(tokens.span(text, i));
+    }
+  }
+
+  if (!words.empty()) {
+    volatile size_t keyword_hits = 0;
+
+    results.push_back(bench("classify_keyword", runs, [&](size_t& bytes) {
+      size_t hits = 0;
+      for (auto& w : words) {
+        if (classify_keyword(w.begin, w.end)) hits++;
+        bytes += w.end - w.begin;
+      }
+      keyword_hits = hits;
+      return words.size();
+    }));
+
+    results.push_back(bench("keyword_linear", runs, [&](size_t& bytes) {
+      size_t hits = 0;
+      for (auto& w : words) {
+        size_t len = w.end - w.begin;
+        for (int k = 1; k < KW_COUNT; k++) {
+          if (!strncmp(w.begin, keyword_names[k], len) && !keyword_names[k][len]) {
+            hits++;
+            break;
+          }
+        }
+        bytes += len;
+      }
+      keyword_hits = hits;
+      return words.size();
+    }));
+  }
+
+  //----------------------------------------
+
+  // Int values, SWAR decode vs strtoull. Both get the same spans, strtoull on
+  // a NUL-terminated copy since it can't take a length.
+  std::vector<cspan> ints;
+  for (size_t i = 0; i < tokens.size(); i++) {
+    if (tokens.types[i] == LEX_INT) ints.push_back(tokens.span(text, i));
+  }
+
+  if (!ints.empty()) {
+    volatile uint64_t int_sum = 0;
+
+    results.push_back(bench("parse_int", runs, [&](size_t& bytes) {
+      uint64_t sum = 0;
+      for (auto& s : ints) {
+        PInt x;
+        if (Parser::parse_int(s, x)) sum += x.u_int;
+        bytes += s.size();
+      }
+      int_sum = sum;
+      return ints.size();
+    }));
+
+    results.push_back(bench("int_strtoull", runs, [&](size_t& bytes) {
+      uint64_t sum = 0;
+      char buf[64];
+      for (auto& s : ints) {
+        size_t len = std::min(s.size(), sizeof(buf) - 1);
+        memcpy(buf, s.begin, len);
+        buf[len] = 0;
+        sum += strtoull(buf, nullptr, 0);
+        bytes += s.size();
+      }
+      int_sum = sum;
+      return ints.size();
+    }));
+  }
+
+  // Float values, decode_float vs copying each literal out for strtod.
+  std::vector<cspan> floats;
+  for (size_t i = 0; i < tokens.size(); i++) {
+    if (tokens.types[i] == LEX_FLOAT) floats.push_back(tokens.span(text, i));
+  }
+
+  if (!floats.empty()) {
+    volatile double float_sum = 0;
+
+    results.push_back(bench("parse_float", runs, [&](size_t& bytes) {
+      double sum = 0;
+      for (auto& s : floats) {
+        PFloat x;
+        if (Parser::parse_float(s, x)) sum += x.value;
+        bytes += s.size();
+      }
+      float_sum = sum;
+      return floats.size();
+    }));
+
+    results.push_back(bench("float_strtod", runs, [&](size_t& bytes) {
+      double sum = 0;
+      char buf[64];
+      for (auto& s : floats) {
+        size_t len = std::min(s.size(), sizeof(buf) - 1);
+        memcpy(buf, s.begin, len);
+        buf[len] = 0;
+        sum += strtod(buf, nullptr);
+        bytes += s.size();
+      }
+      float_sum = sum;
+      return floats.size();
+    }));
+  }
+
+  //----------------------------------------
+
+  results.push_back(bench("lex_next", runs, [&](size_t& bytes) {
+    size_t count = 0;
+    for (size_t i = 0; i < tokens.size(); i++) {
+      LexType type;
+      auto begin = text + tokens.begin_of(i);
+      if (auto end = lex_next(begin, type)) {
+        bytes += end - begin;
+        count++;
+      }
+    }
+    return count;
+  }));
+
+  results.push_back(bench("take_token", runs, [&](size_t& bytes) {
+    Parser p;
+    p.load_view(text, size);
+    size_t count = 0;
+    while (p.cursor < p.source_end) {
+      p.skip_ws();
+      if (p.take_token() || p.take(match_oneline_comment) || p.take(scan_multiline_comment)) {
+        count++;
+      }
+      else if (p.cursor < p.source_end) {
+        p.cursor++;
+      }
+    }
+    bytes = size;
+    return count;
+  }));
+
+  results.push_back(bench("lex_all", runs, [&](size_t& bytes) {
+    TokenBuffer out;
+    lex_all(text, size, out);
+    bytes = size;
+    return out.size();
+  }));
+
+  //----------------------------------------
+  // What a warm TokenCache hit costs instead of lex_all.
+
+  results.push_back(bench("hash64", runs, [&](size_t& bytes) {
+    volatile uint64_t hash = hash64(text, size);
+    (void)hash;
+    bytes = size;
+    return tokens.size();
+  }));
+
+  //----------------------------------------
+  // A location for every token, the way a lint pass reports them. The index
+  // is rebuilt each run so its construction is in the number.
+
+  results.push_back(bench("line_index", runs, [&](size_t& bytes) {
+    LineIndex lines;
+    lines.reset(text, size);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < tokens.size(); i++) {
+      sum += lines.locate(tokens.begin_of(i)).col;
+    }
+    bytes = size;
+    return sum ? tokens.size() : 0;
+  }));
+
+  //----------------------------------------
+  // Phases 1-2. The corpus as-is is mostly one vector compare per block, the
+  // CRLF copy has something to remove on every line.
+
+  {
+    std::string crlf;
+    crlf.reserve(size + size / 16);
+    for (auto c = text; c < text + size; c++) {
+      if (*c == '\n') crlf.push_back('\r');
+      crlf.push_back(*c);
+    }
+
+    std::string out;
+    SpliceMap map;
+
+    results.push_back(bench("translate(lf)", runs, [&](size_t& bytes) {
+      translate_source(text, size, out, map);
+      bytes = size;
+      return map.at.size();
+    }));
+
+    results.push_back(bench("translate(crlf)", runs, [&](size_t& bytes) {
+      translate_source(crlf.c_str(), crlf.size(), out, map);
+      bytes = crlf.size();
+      return map.at.size();
+    }));
+  }
+
+  //----------------------------------------
+  // Expressions, precedence climbing vs a rule per precedence level. Tokens
+  // are counted over the expressions' own text.
+
+  {
+    std::vector<uint32_t> starts;
+    auto exprs = make_expressions(1024 * 1024, starts);
+
+    TokenBuffer expr_tokens;
+    lex_all(exprs.c_str(), exprs.size(), expr_tokens);
+
+    Parser p;
+    p.load(exprs);
+
+    auto run = [&](size_t& bytes, auto&& take) {
+      p.arena.reset();
+      size_t parsed = 0;
+      for (auto s : starts) {
+        p.cursor = p.source_start + s;
+        if (auto e = take()) {
+          bytes += e->span.size();
+          parsed++;
+        }
+      }
+      return parsed == starts.size() ? expr_tokens.size() : 0;
+    };
+
+    results.push_back(bench("take_expression", runs, [&](size_t& bytes) {
+      return run(bytes, [&]() { return p.take_expression(); });
+    }));
+
+    results.push_back(bench("expression_by_level", runs, [&](size_t& bytes) {
+      return run(bytes, [&]() { return naive_expression(p, PREC_COMMA); });
+    }));
+  }
+
+  //----------------------------------------
+
+  if (json_path && !write_json(json_path, results, size)) {
+    fprintf(stderr, "could not write %s\n", json_path);
+    return 2;
+  }
+
+  int regressions = 0;
+  if (baseline_path) {
+    std::vector<BenchResult> baseline;
+    if (!read_json(baseline_path, baseline)) {
+      fprintf(stderr, "could not read %s\n", baseline_path);
+      return 2;
+    }
+
+    printf("\nvs %s (threshold %.1f%%)\n", baseline_path, threshold);
+    for (auto& b : baseline) {
+      for (auto& r : results) {
+        if (r.name != b.name || b.mb_per_sec <= 0) continue;
+        double change = 100.0 * (r.mb_per_sec - b.mb_per_sec) / b.mb_per_sec;
+        bool regressed = change < -threshold;
+        printf("%-28s %+7.1f%%%s\n", r.name.c_str(), change, regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+      }
+    }
+  }
+
+  return regressions ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
@@ -1,16 +1,34 @@
 #include "parseroni/Parser.h"
 
 #include "parseroni/Combinators.h"
+#include "parseroni/CorpusScan.h"
+#include "parseroni/Hash.h"
+#include "parseroni/IncludeGraph.h"
+#include "parseroni/Instrument.h"
+#include "parseroni/Keywords.h"
+#include "parseroni/LineIndex.h"
+#include "parseroni/Numbers.h"
+#include "parseroni/Punctuators.h"
+#include "parseroni/ParallelLex.h"
+#include "parseroni/WorkPool.h"
+#include "parseroni/Lexer.h"
+#include "parseroni/Scanners.h"
+#include "parseroni/Stream.h"
+#include "parseroni/TokenCache.h"
+#include "parseroni/Translate.h"
 
 #include "metrolib/core/Tests.h"
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
 #include <memory.h>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <typeinfo>
+#include <unistd.h>
 
-bool operator == (cspan s, const char* text) {
-  for (auto i = 0; i < s.size(); i++) {
-    if (text[i] == 0 || s[i] != text[i]) return false;
-  }
-  return true;
-}
+using namespace matcheroni;
 
 //------------------------------------------------------------------------------
 
@@ -50,7 +68,6 @@ TestResults test_basic() {
 TestResults test_tokens() {
   TEST_INIT();
 
-#if 0
   Parser p;
   std::optional<cspan> t;
 
@@ -65,27 +82,74 @@ TestResults test_tokens() {
   EXPECT_TRUE(t && t.value() == "+");
   t = p.take_token();
   EXPECT_TRUE(t && t.value() == "b");
-#endif
+
+  // take_punct(id) only matches when that's the longest punctuator there.
+  p.load("<<=<");
+  EXPECT_FALSE(p.take_punct(punct_id("<")).has_value());
+  EXPECT_FALSE(p.take_punct(punct_id("<<")).has_value());
+  t = p.take_punct(punct_id("<<="));
+  EXPECT_TRUE(t && t.value() == "<<=");
+  t = p.take_punct();
+  EXPECT_TRUE(t && t.value() == "<");
+  EXPECT_FALSE(p.take_punct().has_value());
+
+  // Every punctuator matches itself in full, with its own id.
+  for (int i = 1; i < punct_count; i++) {
+    int id = 0;
+    auto text = punctuators[i];
+    EXPECT_EQ(text + strlen(text), scan_punct_id(text, id));
+    EXPECT_EQ(i, id);
+  }
+
+  auto punct_len = [](const char* text) {
+    auto end = scan_punct(text);
+    return end ? int(end - text) : -1;
+  };
+
+  // Longest match falls back to the longest accepted prefix...
+  EXPECT_EQ(1, punct_len(".."));
+  EXPECT_EQ(3, punct_len("->*x"));
+  EXPECT_EQ(2, punct_len("%:%"));
+  EXPECT_EQ(-1, punct_len("a"));
+  EXPECT_EQ(-1, punct_len(""));
+
+  // ...and "<::" is "<" then "::" unless a ':' or '>' follows.
+  EXPECT_EQ(1, punct_len("<::foo>"));
+  EXPECT_EQ(2, punct_len("<:::"));
+  EXPECT_EQ(2, punct_len("<::>"));
 
   TEST_DONE();
 }
 
 //------------------------------------------------------------------------------
 
-TestResults test_match(matcher m, const char* text) {
+template<typename M>
+TestResults test_match(M&& m, const char* text) {
   TestResults results;
   auto end = text + strlen(text);
   EXPECT_EQ(end, m(text));
   return results;
 }
 
-TestResults test_no_match(matcher m, const char* text) {
+template<typename M>
+TestResults test_match(const char* text) {
+  return test_match(M::match, text);
+}
+
+template<typename M>
+TestResults test_no_match(M&& m, const char* text) {
   TestResults results;
   EXPECT_EQ(nullptr, m(text));
   return results;
 }
 
-TestResults test_partial_match(matcher m, const char* text) {
+template<typename M>
+TestResults test_no_match(const char* text) {
+  return test_no_match(M::match, text);
+}
+
+template<typename M>
+TestResults test_partial_match(M&& m, const char* text) {
   TestResults results;
   auto end = text + strlen(text);
   auto match = m(text);
@@ -94,6 +158,14 @@ TestResults test_partial_match(matcher m, const char* text) {
   return results;
 }
 
+// Fixture files for the corpus tests.
+static bool write_file(const std::string& path, const std::string& text) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+  return fclose(f) == 0 && ok;
+}
+
 TestResults test_match_int() {
   TEST_INIT();
 
@@ -356,6 +428,1410 @@ TestResults test_take_lit() {
 
 //------------------------------------------------------------------------------
 
+TestResults test_take_matcher() {
+  TEST_INIT();
+
+  results << test_match<Lit<"#include">>("#include");
+  results << test_no_match<Lit<"#include">>("#inclu");
+
+  Parser p;
+  p.load(R"(#include  "foo/bar.h")");
+
+  auto lit_include = p.take<Lit<"#include">>();
+  auto lit_ws      = p.take(match_ws);
+  auto lit_path    = p.take([](const char* text) { return match_include_path(text); });
+
+  EXPECT_TRUE(lit_include && lit_include.value() == "#include");
+  EXPECT_TRUE(lit_ws && lit_ws.value() == "  ");
+  EXPECT_TRUE(lit_path && lit_path.value() == R"("foo/bar.h")");
+
+  // A failed match must leave the cursor alone.
+  p.load("foo");
+  EXPECT_FALSE(p.take<Lit<"bar">>().has_value());
+  EXPECT_EQ(p.source_start, p.cursor);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_lex_dispatch() {
+  TEST_INIT();
+
+  const char* source = "#include <stdio.h>\nint x = 0x1F + 1.5f; // hi\n/* block */ u8\"str\" 'c' R\"(raw)\"";
+
+  LexType expected[] = {
+    LEX_PREPROC, LEX_SPACE, LEX_PUNCT, LEX_IDENTIFIER, LEX_PUNCT, LEX_IDENTIFIER, LEX_PUNCT, LEX_NEWLINE,
+    LEX_KEYWORD, LEX_SPACE, LEX_IDENTIFIER, LEX_SPACE, LEX_PUNCT, LEX_SPACE, LEX_INT, LEX_SPACE,
+    LEX_PUNCT, LEX_SPACE, LEX_FLOAT, LEX_PUNCT, LEX_SPACE, LEX_COMMENT1, LEX_NEWLINE,
+    LEX_COMMENT2, LEX_SPACE, LEX_STRING, LEX_SPACE, LEX_CHAR_LITERAL, LEX_SPACE, LEX_RAW_STRING,
+  };
+
+  auto cursor = source;
+  for (auto e : expected) {
+    LexType type;
+    auto end = lex_next(cursor, type);
+    EXPECT_NE(nullptr, end);
+    EXPECT_EQ(e, type);
+    if (!end) break;
+    cursor = end;
+  }
+  EXPECT_EQ(0, *cursor);
+
+  // Encoding prefixes belong to the char literal, not to an identifier before
+  // it - for take_token() too.
+  for (auto text : { "L'a'", "u'b'", "U'c'", "u8'd'", "L'\\''" }) {
+    LexType type;
+    EXPECT_EQ(text + strlen(text), lex_next(text, type));
+    EXPECT_EQ(LEX_CHAR_LITERAL, type);
+
+    Parser p;
+    p.load(text);
+    auto token = p.take_token();
+    EXPECT_TRUE(token && token->size() == strlen(text));
+  }
+
+  Parser p;
+  p.load("u8\"str\"");
+  auto token = p.take_token();
+  EXPECT_TRUE(token && *token == "u8\"str\"");
+
+  // Nothing can start with a NUL.
+  LexType type;
+  EXPECT_EQ(nullptr, lex_next("", type));
+  EXPECT_EQ(LEX_INVALID, type);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_keywords() {
+  TEST_INIT();
+
+  // Every keyword classifies as itself...
+  for (int k = 1; k < KW_COUNT; k++) {
+    auto name = keyword_names[k];
+    EXPECT_EQ(k, int(classify_keyword(name, name + strlen(name))));
+  }
+
+  // ...and prefixes, extensions, and case changes of them don't.
+  const char* not_keywords[] = {
+    "i", "in", "integer", "Int", "autos", "_", "_Bool_", "_Static_asser",
+    "_Thread_locals", "constexpr", "whiles", "x", "do_", "ifdef",
+  };
+  for (auto word : not_keywords) {
+    EXPECT_EQ(KW_NONE, classify_keyword(word, word + strlen(word)));
+  }
+
+  // Sets and whole-identifier matching in the parser.
+  Parser p;
+  p.load("unsigned integer const static");
+  EXPECT_TRUE(p.take_signed_specifier().has_value());
+  p.skip_ws();
+  EXPECT_FALSE(p.take_primitive_type().has_value());
+  EXPECT_FALSE(p.take_keyword(KW_INT).has_value());
+  EXPECT_TRUE(p.take(scan_identifier).has_value());
+  p.skip_ws();
+  EXPECT_FALSE(p.take_storage_class_specifier().has_value());
+  EXPECT_TRUE(p.take_type_qualifier().has_value());
+  p.skip_ws();
+  EXPECT_TRUE(p.take_keyword(KW_STATIC).has_value());
+  EXPECT_EQ(p.source_end, p.cursor);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_numbers() {
+  TEST_INIT();
+
+  auto number_len = [](const char* text) {
+    auto end = scan_number(text);
+    return end ? int(end - text) : -1;
+  };
+
+  // Whole pp-numbers, well formed or not.
+  EXPECT_EQ(4,  number_len("1.5f;"));
+  EXPECT_EQ(5,  number_len("1e+10)"));
+  EXPECT_EQ(6,  number_len("0x1p-3"));
+  EXPECT_EQ(5,  number_len("1.2.3"));
+  EXPECT_EQ(6,  number_len("0x1e+1"));
+  EXPECT_EQ(4,  number_len("10ms"));
+  EXPECT_EQ(1,  number_len("1+2"));
+  EXPECT_EQ(2,  number_len(".5"));
+  EXPECT_EQ(-1, number_len("."));
+  EXPECT_EQ(-1, number_len("-1"));
+
+  NumberInfo info;
+  scan_number("0x1Full", info);
+  EXPECT_TRUE(info.valid && !info.is_float && info.is_unsigned);
+  EXPECT_EQ(16, info.base);
+  EXPECT_EQ(2, info.longs);
+
+  scan_number("0777", info);
+  EXPECT_TRUE(info.valid);
+  EXPECT_EQ(8, info.base);
+
+  const char* bad[] = { "09", "10lL", "10ms", "1e", "0x1.8", "0b1.0", "1.5q" };
+  for (auto text : bad) {
+    scan_number(text, info);
+    EXPECT_FALSE(info.valid);
+  }
+
+  // Values and overflow in every base.
+  struct IntCase { const char* text; bool ok; uint64_t value; };
+  IntCase cases[] = {
+    { "0",                                       true,  0 },
+    { "-0x8000000000000000",                     true,  0x8000000000000000 },
+    { "-0x8000000000000001",                     false, 0 },
+    { "18446744073709551615",                    true,  UINT64_MAX },
+    { "18446744073709551616",                    false, 0 },
+    { "0xFFFFFFFFFFFFFFFFull",                   true,  UINT64_MAX },
+    { "0x10000000000000000",                     false, 0 },
+    { "01777777777777777777777",                 true,  UINT64_MAX },
+    { "02000000000000000000000",                 false, 0 },
+    { "0b0000000000000000000000000000000000000000000000000000000000000000000101", true, 5 },
+    { "1.5",                                     false, 0 },
+    { "0x",                                      false, 0 },
+  };
+  for (auto& c : cases) {
+    PInt x;
+    EXPECT_EQ(c.ok, Parser::parse_int(cspan(c.text, c.text + strlen(c.text)), x));
+    if (c.ok) EXPECT_EQ(c.value, x.u_int);
+  }
+
+  // The SWAR decoder against snprintf's idea of every base.
+  uint64_t seed = 5;
+  int bases[] = { 10, 16, 8 };
+  char buf[80];
+  for (int rep = 0; rep < 10000; rep++) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    uint64_t v = seed >> (rep % 64);
+    int base = bases[rep % 3];
+    snprintf(buf, sizeof(buf), base == 10 ? "%llu" : base == 16 ? "0x%llx" : "0%llo", (unsigned long long)v);
+
+    PInt x;
+    EXPECT_TRUE(Parser::parse_int(cspan(buf, buf + strlen(buf)), x));
+    EXPECT_EQ(v, x.u_int);
+  }
+
+  // The lexer takes numbers in one go and doesn't swallow signs any more.
+  TokenBuffer tokens;
+  const char* source = "x=-1.5e3f+0x10u";
+  EXPECT_TRUE(lex_all(source, strlen(source), tokens));
+  uint8_t expected[] = { LEX_IDENTIFIER, LEX_PUNCT, LEX_PUNCT, LEX_FLOAT, LEX_PUNCT, LEX_INT };
+  EXPECT_TRUE(std::vector<uint8_t>(expected, expected + 6) == tokens.types);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Float values have to match strtod bit for bit - halfway cases, subnormals,
+// overflow, and mantissas too long for Eisel-Lemire alone.
+
+TestResults test_floats() {
+  TEST_INIT();
+
+  auto same_as_strtod = [](const char* text) {
+    PFloat f;
+    if (!Parser::parse_float(cspan(text, text + strlen(text)), f)) return false;
+    double expected = strtod(text, nullptr);
+    return memcmp(&expected, &f.value, sizeof(double)) == 0;
+  };
+
+  const char* cases[] = {
+    "1.0", "0.1", "1e23", "9007199254740993.0", "2.2250738585072011e-308",
+    "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+    "1e-400", "1e400", "1.7976931348623157e308", "1.7976931348623159e308",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "3.14159265358979323846264338327950288419716939937510", "-0.0", "-1.5e-3",
+    "0x1p-1074", "0x1p-1075", "0x1.8p-1075", "0x1.fffffffffffff8p1023",
+    "0x1.00000000000008p0", "0x1.000000000000080001p0", "0x.8p1", "0xAp0",
+  };
+  for (auto text : cases) EXPECT_TRUE(same_as_strtod(text));
+
+  uint64_t seed = 9;
+  char buf[128];
+  for (int rep = 0; rep < 100000; rep++) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    double d;
+    memcpy(&d, &seed, sizeof(d));
+    if (!std::isfinite(d)) continue;
+
+    switch (rep % 3) {
+      case 0: snprintf(buf, sizeof(buf), "%.17e", fabs(d)); break;
+      case 1: snprintf(buf, sizeof(buf), "%.*e", rep % 25, fabs(d)); break;
+      case 2: snprintf(buf, sizeof(buf), "%a", fabs(d)); break;
+    }
+    EXPECT_TRUE(same_as_strtod(buf));
+  }
+
+  PFloat f;
+  const char* single = "2.5f";
+  EXPECT_TRUE(Parser::parse_float(cspan(single, single + 4), f));
+  EXPECT_TRUE(f.is_single && f.value == 2.5);
+
+  // Ints and malformed literals aren't floats.
+  const char* bad[] = { "1", "0x1.8", "1.5q", "1e" };
+  for (auto text : bad) EXPECT_FALSE(Parser::parse_float(cspan(text, text + strlen(text)), f));
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_token_buffer() {
+  TEST_INIT();
+
+  std::string source = "#define X(a) \\\n  ((a) * 2)\nint main() { return X(\"str\"[0]); } /* end */\n";
+
+  TokenBuffer tokens;
+  EXPECT_TRUE(lex_all(source.c_str(), source.size(), tokens));
+  EXPECT_EQ(tokens.types.size(), tokens.ends.size());
+  EXPECT_EQ(source.size(), size_t(tokens.ends.back()));
+
+  // Same tokens as lexing one at a time, and they tile the source exactly.
+  auto cursor = source.c_str();
+  std::string rebuilt;
+  for (size_t i = 0; i < tokens.size(); i++) {
+    auto span = tokens.span(source.c_str(), i);
+    EXPECT_EQ(cursor, span.begin);
+
+    if (tokens.types[i] == LEX_SPLICE) {
+      EXPECT_TRUE(span == "\\\n");
+    }
+    else {
+      LexType type;
+      EXPECT_EQ(span.end, lex_next(cursor, type));
+      EXPECT_EQ(type, tokens.types[i]);
+    }
+
+    rebuilt.append(span.begin, span.end);
+    cursor = span.end;
+  }
+  EXPECT_EQ(source, rebuilt);
+
+  // '$' and UTF-8 bytes are identifier characters.
+  std::string wide = "int $x = caf\xC3\xA9;";
+  EXPECT_TRUE(lex_all(wide.c_str(), wide.size(), tokens));
+  EXPECT_EQ(8u, tokens.size());
+  EXPECT_EQ(LEX_IDENTIFIER, tokens.types[2]);
+  EXPECT_TRUE(tokens.span(wide.c_str(), 2) == "$x");
+  EXPECT_EQ(LEX_IDENTIFIER, tokens.types[6]);
+  EXPECT_TRUE(tokens.span(wide.c_str(), 6) == "caf\xC3\xA9");
+
+  // Bytes no punctuator starts with are one-byte tokens, and CRLF splices
+  // are splices.
+  const char* strays[] = { "a ` b", "x @ y", "a \\ b", "s = \"abc\n", "c = '\n" };
+  for (auto text : strays) EXPECT_TRUE(lex_all(text, strlen(text), tokens));
+
+  std::string crlf = "a \\\r\nb";
+  EXPECT_TRUE(lex_all(crlf.c_str(), crlf.size(), tokens));
+  EXPECT_EQ(4u, tokens.size());
+  EXPECT_EQ(LEX_SPLICE, tokens.types[2]);
+  EXPECT_TRUE(tokens.span(crlf.c_str(), 2) == "\\\r\n");
+
+  // A lone quote is only a fallback if its literal ran off the end.
+  const char* cut = "\"abc\\\"";
+  EXPECT_TRUE(lex_is_fallback(cut, cut + 1, LEX_PUNCT));
+  const char* unterminated = "\"abc\nx\"";
+  EXPECT_FALSE(lex_is_fallback(unterminated, unterminated + 1, LEX_PUNCT));
+
+  // Lexing stops at the first bad byte and keeps what it had so far.
+  std::string bad = "int x = \x01;";
+  EXPECT_FALSE(lex_all(bad.c_str(), bad.size(), tokens));
+  EXPECT_EQ(8u, tokens.ends.back());
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// The vector kernels have to agree with a plain byte loop at every alignment
+// and run length, including runs and literals that end right at the terminator.
+
+TestResults test_scanners() {
+  TEST_INIT();
+
+  const char* alphabet = " \t\v\f\n\rab_Z09$.\x80";
+  int alphabet_len = (int)strlen(alphabet) + 1; // '\x80' counts too
+
+  char buf[256];
+  uint32_t seed = 1;
+
+  for (int rep = 0; rep < 2000; rep++) {
+    int len = rep % 100;
+    for (int i = 0; i < len; i++) {
+      seed = seed * 1664525 + 1013904223;
+      // Long runs of the same class are the interesting case.
+      int pick = (seed >> 16) % (rep & 1 ? alphabet_len - 1 : 4);
+      buf[i] = alphabet[pick];
+    }
+    buf[len] = 0;
+
+    for (int start = 0; start <= len; start++) {
+      auto text = buf + start;
+
+      auto ref_space = text; while (*ref_space == ' ' || *ref_space == '\t' || *ref_space == '\v' || *ref_space == '\f') ref_space++;
+      auto ref_ws    = text; while (isspace(uint8_t(*ref_ws))) ref_ws++;
+      auto ref_ident = text; while (isalnum(uint8_t(*ref_ident)) || *ref_ident == '_' || *ref_ident == '$' || uint8_t(*ref_ident) >= 0x80) ref_ident++;
+
+      EXPECT_EQ(ref_space, skip_space_run(text));
+      EXPECT_EQ(ref_ws,    skip_ws_run(text));
+      EXPECT_EQ(ref_ident, skip_ident_run(text));
+    }
+  }
+
+  // Strings and comments, against the obvious byte-at-a-time versions.
+  auto ref_quoted = [](const char* text, char quote) -> const char* {
+    if (*text++ != quote) return nullptr;
+    for (; *text; text++) {
+      if (*text == quote) return text + 1;
+      if (*text == '\n') return nullptr;
+      if (*text == '\\' && !*++text) return nullptr;
+    }
+    return nullptr;
+  };
+
+  auto ref_comment = [](const char* text) -> const char* {
+    if (text[0] != '/' || text[1] != '*') return nullptr;
+    for (text += 2; *text; text++) {
+      if (text[0] == '*' && text[1] == '/') return text + 2;
+    }
+    return nullptr;
+  };
+
+  const char* body = "aaaaaaa\"\\\n'*/";
+  for (int rep = 0; rep < 2000; rep++) {
+    int len = rep % 120;
+    for (int i = 0; i < len; i++) {
+      seed = seed * 1664525 + 1013904223;
+      buf[i] = body[(seed >> 16) % strlen(body)];
+    }
+    buf[len] = 0;
+
+    for (int start = 0; start < len; start++) {
+      auto text = buf + start;
+      EXPECT_EQ(ref_quoted(text, '"'),  scan_string(text));
+      EXPECT_EQ(ref_quoted(text, '\''), scan_char_literal(text));
+      if (start + 1 < len) {
+        text[0] = '/';
+        text[1] = '*';
+        EXPECT_EQ(ref_comment(text), scan_multiline_comment(text));
+      }
+    }
+  }
+
+  results << test_match(scan_string, R"(u8"\"a\\b\n")");
+  results << test_match(scan_string, "L\"line \\\r\nsplice\"");
+  results << test_no_match(scan_string, "\"unterminated\nstring\"");
+  results << test_match(scan_char_literal, R"('\'')");
+  results << test_match(scan_multiline_comment, "/* a * b ** / c **/");
+  results << test_no_match(scan_multiline_comment, "/* a * b ** / c *");
+
+  results << test_match(scan_identifier, "_foo_Bar_0123456789_abcdefghijklmnopqrstuvwxyz");
+  results << test_no_match(scan_identifier, "0foo");
+  results << test_no_match(scan_space, "\n");
+  results << test_partial_match(scan_space, " \t \n");
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// translate_source has to agree with a byte-at-a-time reference at every
+// alignment, and the map has to put every logical byte back where it came from.
+
+TestResults test_translate() {
+  TEST_INIT();
+
+  std::string logical;
+  SpliceMap map;
+
+  EXPECT_FALSE(translate_source("int x;\n", 7, logical, map));
+  EXPECT_TRUE(logical.empty() && map.empty());
+
+  std::string text = "fo\\\no\r\nba\\\r\n\\\nr \\x \r";
+  EXPECT_TRUE(translate_source(text.c_str(), text.size(), logical, map));
+  EXPECT_TRUE(logical == "foo\nbar \\x \r");
+  EXPECT_EQ(3, map.at.size());
+  EXPECT_EQ(0, map.to_physical(0));
+  EXPECT_EQ(4, map.to_physical(2));   // the second 'o', past the splice
+  EXPECT_EQ(2, map.to_physical_end(2));
+  EXPECT_EQ(6, map.to_physical(3));   // the LF of the CRLF
+  EXPECT_EQ(text.size(), map.to_physical_end(uint32_t(logical.size())));
+
+  const char* alphabet = "\\\r\na";
+  uint32_t seed = 3;
+  for (int rep = 0; rep < 200; rep++) {
+    std::string buf(64, 'x');
+    int len = rep % 97;
+    for (int i = 0; i < len; i++) {
+      seed = seed * 1664525 + 1013904223;
+      buf.push_back(alphabet[(seed >> 16) % 4]);
+    }
+
+    for (int align = 0; align < 33; align++) {
+      std::string phys = buf.substr(64 - align);
+
+      std::string expected;
+      for (size_t i = 0; i < phys.size();) {
+        if (phys[i] == '\\' && phys[i + 1] == '\n') i += 2;
+        else if (phys[i] == '\\' && phys[i + 1] == '\r' && phys[i + 2] == '\n') i += 3;
+        else if (phys[i] == '\r' && phys[i + 1] == '\n') i += 1;
+        else expected.push_back(phys[i++]);
+      }
+
+      bool changed = translate_source(phys.c_str(), phys.size(), logical, map);
+      if (!changed) logical = phys;
+      EXPECT_EQ(changed, expected != phys);
+      EXPECT_TRUE(expected == logical);
+
+      for (size_t i = 0; i < logical.size(); i++) {
+        EXPECT_EQ(logical[i], phys[map.to_physical(uint32_t(i))]);
+      }
+    }
+  }
+
+  // The parser sees joined lines, and spans still point at the original.
+  Parser p;
+  p.load_translated("int fo\\\no = 1;\r\n");
+  p.take_token();
+  p.skip_ws();
+  auto token = p.take_token();
+  EXPECT_TRUE(token && token.value() == "foo");
+  EXPECT_EQ(4, p.physical_begin(token.value()));
+  EXPECT_EQ(9, p.physical_end(token.value()));
+
+  p.load("int x;");
+  EXPECT_TRUE(p.splices.empty());
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Every offset has to land on the same line and column as a walk from the top
+// of the buffer, whatever order the lookups come in.
+
+TestResults test_line_index() {
+  TEST_INIT();
+
+  const char* alphabet[] = { "a", "\n", "\t", "\xC3\xA9", "\xE2\x82\xAC", "\r\n", " " };
+  uint32_t seed = 5;
+
+  std::string text;
+  for (int i = 0; i < 200000; i++) {
+    seed = seed * 1664525 + 1013904223;
+    text += alphabet[(seed >> 16) % 7];
+  }
+
+  // count_newlines at every alignment and length.
+  for (int begin = 0; begin < 70; begin++) {
+    for (int len = 0; len < 200; len += 7) {
+      auto s = text.c_str() + begin;
+      EXPECT_EQ(size_t(std::count(s, s + len, '\n')), count_newlines(s, s + len));
+    }
+  }
+
+  std::vector<SourceLocation> expected;
+  SourceLocation loc = {1, 1, 1};
+  for (size_t i = 0; i <= text.size(); i++) {
+    expected.push_back(loc);
+    if (i == text.size()) break;
+    uint8_t c = text[i];
+    if (c == '\n') {
+      loc = {loc.line + 1, 1, 1};
+      continue;
+    }
+    loc.byte_col++;
+    if (c == '\t') loc.col = (loc.col - 1) / 8 * 8 + 9;
+    else if ((c & 0xC0) != 0x80) loc.col++;
+  }
+
+  LineIndex lines;
+  lines.reset(text.c_str(), text.size());
+
+  // Backwards, then forwards, then scattered.
+  for (size_t pass = 0; pass < 3; pass++) {
+    for (size_t i = 0; i <= text.size(); i += 97) {
+      size_t offset = pass == 0 ? text.size() - i : pass == 1 ? i : (i * 7919) % (text.size() + 1);
+      auto got = lines.locate(offset);
+      auto& want = expected[offset];
+      EXPECT_EQ(want.line, got.line);
+      EXPECT_EQ(want.col, got.col);
+      EXPECT_EQ(want.byte_col, got.byte_col);
+    }
+    if (pass == 0) lines.reset(text.c_str(), text.size());
+  }
+  EXPECT_EQ(expected.back().line, lines.line_count());
+
+  // Nothing is scanned until it's needed.
+  lines.reset(text.c_str(), text.size());
+  lines.locate(10);
+  EXPECT_TRUE(lines.scanned < text.size());
+
+  // The parser reports against the text as written, splices and all.
+  Parser p;
+  p.load_translated("int a;\r\n#define X \\\n  y\nfoo");
+  p.cursor = p.source_end - 3;
+  auto at = p.locate(p.cursor);
+  EXPECT_EQ(4, at.line);
+  EXPECT_EQ(1, at.col);
+
+  p.load("x\n\ty");
+  at = p.locate(p.source_end - 1);
+  EXPECT_EQ(2, at.line);
+  EXPECT_EQ(9, at.col);
+  EXPECT_EQ(2, at.byte_col);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Mapped files must come with a zero sentinel whatever their size, including
+// sizes that land exactly on a page boundary.
+
+TestResults test_load_file() {
+  TEST_INIT();
+
+  size_t page = size_t(sysconf(_SC_PAGESIZE));
+  size_t sizes[] = { 0, 1, page - 1, page, page + 1, 2 * page };
+
+  for (auto size : sizes) {
+    std::string text(size, 'x');
+    for (size_t i = 0; i < size; i++) text[i] = "abc \n"[i % 5];
+
+    char path[] = "/tmp/parseroni_test_XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_NE(-1, fd);
+    EXPECT_EQ(ssize_t(size), write(fd, text.data(), size));
+    close(fd);
+
+    Parser p;
+    EXPECT_TRUE(p.load_file(path));
+    EXPECT_EQ(size, size_t(p.source_end - p.source_start));
+    EXPECT_EQ(0, *p.source_end);
+    EXPECT_EQ(0, memcmp(text.data(), p.source_start, size));
+    EXPECT_EQ(p.source_start, p.cursor);
+
+    unlink(path);
+  }
+
+  Parser p;
+  EXPECT_FALSE(p.load_file("/nonexistent/parseroni/file.c"));
+  EXPECT_EQ(p.source_start, p.source_end);
+
+  // Views are used in place, trailing NULs are not part of the source.
+  const char view[] = "int x;\0\0";
+  p.load_view(view, sizeof(view) - 1);
+  EXPECT_EQ(view, p.source_start);
+  EXPECT_EQ(view + 6, p.source_end);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_arena() {
+  TEST_INIT();
+
+  Arena arena(1024);
+
+  // Allocations are aligned and don't overlap, including ones bigger than a
+  // block.
+  for (int i = 0; i < 1000; i++) {
+    size_t size  = (i * 37) % 300 + 1;
+    size_t align = size_t(1) << (i % 5);
+    if (i % 100 == 0) size = 5000;
+
+    auto p = (char*)arena.alloc(size, align);
+    EXPECT_EQ(0u, uintptr_t(p) % align);
+    memset(p, 0xAA, size);
+  }
+
+  // A reset and the same allocation pattern again shouldn't need any more
+  // memory.
+  auto reserved = arena.bytes_reserved();
+  arena.reset();
+  for (int i = 0; i < 1000; i++) {
+    size_t size  = (i * 37) % 300 + 1;
+    size_t align = size_t(1) << (i % 5);
+    if (i % 100 == 0) size = 5000;
+    arena.alloc(size, align);
+  }
+  EXPECT_EQ(reserved, arena.bytes_reserved());
+
+  // Child vectors grow inside the arena.
+  auto unit = arena.create<PTranslationUnit>(&arena);
+  for (int i = 0; i < 1000; i++) unit->children.push_back(arena.create<PNode>());
+  EXPECT_EQ(1000u, unit->children.size());
+  EXPECT_EQ(nullptr, unit->children[999]->parent);
+
+  // Parse trees come out of the parser's arena and go away on the next load.
+  Parser p;
+  p.load("   \n   ");
+  auto tu = p.take_translation_unit();
+  EXPECT_TRUE(tu.has_value());
+  EXPECT_EQ(1u, tu.value()->children.size());
+  p.load("  ");
+  auto tu2 = p.take_translation_unit();
+  EXPECT_EQ((void*)tu.value(), (void*)tu2.value());
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_checkpoint() {
+  TEST_INIT();
+
+  Parser p;
+  p.load("foo bar baz");
+
+  // Nested spans on the inline stack.
+  p.start_span();
+  p.take(scan_identifier);
+  p.start_span();
+  p.skip_ws();
+  p.take(scan_identifier);
+  EXPECT_EQ(2, p.cursor_stack.size());
+  EXPECT_TRUE(p.top_span() == " bar");
+  p.pop_cursor();
+  EXPECT_TRUE(p.take_top_span() == "foo");
+  EXPECT_TRUE(p.cursor_stack.empty());
+
+  // Checkpoints put the cursor back unless committed.
+  {
+    Parser::Checkpoint cp(p);
+    p.skip_ws();
+    p.take(scan_identifier);
+    EXPECT_TRUE(cp.span() == " bar");
+  }
+  EXPECT_EQ(p.source_start + 3, p.cursor);
+
+  {
+    Parser::Checkpoint cp(p);
+    p.skip_ws();
+    p.take(scan_identifier);
+    EXPECT_TRUE(cp.commit() == " bar");
+  }
+  EXPECT_EQ(p.source_start + 7, p.cursor);
+
+  // A failed rule leaves nothing behind, and a load clears the stack.
+  p.load("#include");
+  EXPECT_EQ(nullptr, p.take_preproc_include());
+  EXPECT_EQ(p.source_start, p.cursor);
+  p.start_span();
+  p.load("x");
+  EXPECT_TRUE(p.cursor_stack.empty());
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_memo() {
+  TEST_INIT();
+
+  // An empty table misses without ever allocating.
+  MemoTable table;
+  MemoResult r = {};
+  EXPECT_FALSE(table.lookup(0, 0, r));
+  EXPECT_EQ(1u, table.misses);
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    table.store(int(i % 7), i, {(const char*)(uintptr_t)(i + 1), nullptr});
+  }
+  EXPECT_EQ(10000u, table.size());
+
+  EXPECT_TRUE(table.lookup(3, 3, r));
+  EXPECT_EQ((const char*)4, r.end);
+  EXPECT_FALSE(table.lookup(4, 3, r));
+
+  // Clearing empties the table but leaves the stats alone.
+  table.clear();
+  EXPECT_EQ(0u, table.size());
+  EXPECT_FALSE(table.lookup(3, 3, r));
+  EXPECT_EQ(1u, table.hits);
+  EXPECT_EQ(3u, table.misses);
+
+  // A memoized rule only runs once per offset, failures included.
+  Parser p;
+  p.load("#include <foo.h>\nint x;");
+  p.enable_memo(true);
+
+  int calls = 0;
+  auto rule = [&]() {
+    calls++;
+    return p.take(scan_identifier);
+  };
+
+  EXPECT_FALSE(p.memoize(RULE_USER, rule).has_value());
+  EXPECT_FALSE(p.memoize(RULE_USER, rule).has_value());
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(1u, p.memo.hits);
+
+  // Two alternatives that both start with an #include - the first fails after
+  // it, the second gets the same node back from the table without parsing or
+  // allocating anything.
+  auto hits = p.memo.hits;
+
+  auto inc1 = p.take_preproc_include();
+  EXPECT_NE(nullptr, inc1);
+  auto after = p.cursor;
+  auto bytes = p.arena.bytes_used();
+  EXPECT_FALSE(p.take_lit("#define").has_value());
+
+  p.cursor = p.source_start;
+  auto inc2 = p.take_preproc_include();
+  EXPECT_EQ(inc1, inc2);
+  EXPECT_EQ(after, p.cursor);
+  EXPECT_EQ(hits + 1, p.memo.hits);
+  EXPECT_EQ(bytes, p.arena.bytes_used());
+  EXPECT_TRUE(p.take_ws().has_value());
+
+  // And a fresh load forgets everything.
+  p.load("#include <foo.h>");
+  EXPECT_EQ(0u, p.memo.size());
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// An edited tree has to look exactly like a fresh parse of the edited text.
+
+TestResults test_apply_edit() {
+  TEST_INIT();
+
+  auto shape = [](PTranslationUnit* unit) {
+    std::vector<std::tuple<size_t, size_t, const char*>> result;
+    for (auto c : unit->children) {
+      result.push_back({c->span.begin - unit->span.begin, c->span.end - unit->span.begin, typeid(*c).name()});
+    }
+    result.push_back({0, unit->span.size(), "unit"});
+    return result;
+  };
+
+  std::string source;
+  for (int i = 0; i < 200; i++) {
+    source += "#include <foo" + std::to_string(i) + ".h>\n";
+    source += "int x" + std::to_string(i) + " = " + std::to_string(i) + "; // note\n";
+  }
+
+  const char* inserts[] = {
+    "", "y", " ", "\n", "/* c */", "+", "#include <bar.h>\n", "\"s\"", "99",
+    "/*", "*/", "\"", "'", "<", ">",
+  };
+  int insert_count = sizeof(inserts) / sizeof(inserts[0]);
+
+  Parser p;
+  p.load(source);
+  p.take_translation_unit();
+
+  uint32_t seed = 3;
+  for (int rep = 0; rep < 200; rep++) {
+    seed = seed * 1664525 + 1013904223;
+    size_t offset  = (seed >> 8) % (source.size() + 1);
+    size_t removed = std::min(size_t((seed >> 4) % 8), source.size() - offset);
+    std::string inserted = inserts[(seed >> 20) % insert_count];
+
+    auto unit = p.apply_edit(offset, removed, inserted);
+    EXPECT_NE(nullptr, unit);
+    source.replace(offset, removed, inserted);
+
+    Parser fresh;
+    fresh.load(source);
+    auto expected = fresh.take_translation_unit().value();
+
+    EXPECT_EQ(source, std::string(p.source_start, p.source_end));
+    EXPECT_TRUE(shape(expected) == shape(unit));
+
+    // Links have to be consistent too.
+    for (size_t i = 0; i < unit->children.size(); i++) {
+      auto c = unit->children[i];
+      EXPECT_EQ(unit, c->parent);
+      EXPECT_EQ(i ? unit->children[i - 1] : nullptr, c->prev);
+    }
+  }
+
+  // Edits that open or close a comment, a literal or an #include path change
+  // how text well before them parses.
+  struct Edit {
+    const char* text;
+    size_t offset, removed;
+    const char* inserted;
+  };
+  Edit edits[] = {
+    { "/* abc def ghi jkl",              18, 0, " */" },
+    { "/* abc */ def ghi jkl",            7, 2, "" },
+    { "#include <foo.h\nint x;\n",       14, 0, ">" },
+    { "#include <foo.h>\nint x;\n",      15, 1, "" },
+    { "#include \"a/long/path.h\nint x;", 23, 0, "\"" },
+    { "s = \"abc def ghi jkl",            19, 0, "\"" },
+    { "s = \"abc def\" ghi jkl;",         12, 1, "" },
+    { "c = 'a + b + c + d",               17, 0, "'" },
+    { "s = L\"abc def ghi",               17, 0, "\"" },
+  };
+  for (auto& e : edits) {
+    Parser q;
+    q.load(e.text);
+    q.take_translation_unit();
+    auto unit = q.apply_edit(e.offset, e.removed, e.inserted);
+
+    std::string text = e.text;
+    text.replace(e.offset, e.removed, e.inserted);
+    Parser fresh;
+    fresh.load(text);
+    EXPECT_TRUE(shape(fresh.take_translation_unit().value()) == shape(unit));
+  }
+
+  // A one-character edit in the middle of a big file reuses almost everything.
+  // (The random edits above may well have left stuff that doesn't parse.)
+  source.clear();
+  for (int i = 0; i < 1000; i++) source += "int x" + std::to_string(i) + ";\n";
+  p.load(source);
+  p.take_translation_unit();
+  p.apply_edit(source.size() / 2, 0, " ");
+  EXPECT_TRUE(p.edit_reparsed < 10);
+  EXPECT_TRUE(p.edit_reused > 1000);
+
+  // Thousands of edits don't grow the arena without bound - replaced nodes
+  // get swept up by the occasional full reparse.
+  source.insert(source.size() / 2, " ");
+  size_t reserved = p.arena.bytes_reserved();
+  for (int rep = 0; rep < 5000; rep++) {
+    size_t offset = (rep * 7919) % source.size();
+    std::string inserted = rep & 1 ? "" : "x";
+    size_t removed = rep & 1 ? 1 : 0;
+    p.apply_edit(offset, removed, inserted);
+    source.replace(offset, removed, inserted);
+  }
+  EXPECT_EQ(source, std::string(p.source_start, p.source_end));
+  EXPECT_TRUE(p.arena.bytes_reserved() <= 4 * reserved);
+
+  // Out of range
+  EXPECT_EQ(nullptr, p.apply_edit(source.size() + 10, 0, "x"));
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Expressions, printed back fully parenthesized so the tree shape is easy to
+// check.
+
+static std::string render(PNode* n) {
+  auto text = [](PNode* n) { return std::string(n->span.begin, n->span.end); };
+
+  if (auto e = dynamic_cast<PBinaryExpression*>(n)) {
+    return "(" + render(e->lhs) + " " + text(e->op) + " " + render(e->rhs) + ")";
+  }
+  if (auto e = dynamic_cast<PAssignmentExpression*>(n)) {
+    return "{" + render(e->lhs) + " " + text(e->op) + " " + render(e->rhs) + "}";
+  }
+  if (auto e = dynamic_cast<PConditionalExpression*>(n)) {
+    return "(" + render(e->condition) + " ? " + render(e->consequence) + " : " + render(e->alternative) + ")";
+  }
+  if (auto e = dynamic_cast<PUnaryExpression*>(n)) {
+    return "(" + text(e->op) + " " + render(e->operand) + ")";
+  }
+  if (auto e = dynamic_cast<PPostfixExpression*>(n)) {
+    return "(" + render(e->operand) + " " + text(e->op) + ")";
+  }
+  if (auto e = dynamic_cast<PParenExpression*>(n)) {
+    return "[" + render(e->expression) + "]";
+  }
+  if (auto e = dynamic_cast<PSubscriptExpression*>(n)) {
+    return render(e->array) + "[" + render(e->index) + "]";
+  }
+  if (auto e = dynamic_cast<PMemberExpression*>(n)) {
+    return render(e->object) + text(e->op) + text(e->member);
+  }
+  if (auto e = dynamic_cast<PCallExpression*>(n)) {
+    std::string result = render(e->function) + "(";
+    for (PNode* a = e->args->arg_head; a; a = a->next) {
+      result += render(a);
+      if (a->next) result += ", ";
+    }
+    return result + ")";
+  }
+  return text(n);
+}
+
+TestResults test_expressions() {
+  TEST_INIT();
+
+  Parser p;
+  auto parse = [&p](const char* text) -> std::string {
+    p.load(text);
+    auto e = p.take_expression();
+    return e ? render(e) : "<none>";
+  };
+
+  // Precedence and associativity
+  EXPECT_EQ("(a + (b * c))",         parse("a + b * c"));
+  EXPECT_EQ("((a - b) - c)",         parse("a - b - c"));
+  EXPECT_EQ("{a = {b = c}}",         parse("a = b = c"));
+  EXPECT_EQ("{x |= ((1 << n) & m)}", parse("x |= 1 << n & m"));
+  EXPECT_EQ("((a || (b && c)) || d)", parse("a || b && c || d"));
+  EXPECT_EQ("((a == b) != (c < d))", parse("a == b != c < d"));
+  EXPECT_EQ("((a , b) , c)",         parse("a, b, c"));
+  EXPECT_EQ("({x = 1} , y)",         parse("x = 1, y"));
+
+  // Conditionals nest to the right, and the middle can be anything.
+  EXPECT_EQ("(a ? b : (c ? d : e))", parse("a ? b : c ? d : e"));
+  EXPECT_EQ("{x = (a ? {b = c} : d)}", parse("x = a ? b = c : d"));
+
+  // Unary, postfix and primaries
+  EXPECT_EQ("((- (~ x)) + (! y))",   parse("-~x + !y"));
+  EXPECT_EQ("(- (a[i] ++))",         parse("-a[i]++"));
+  EXPECT_EQ("(sizeof x)",            parse("sizeof x"));
+  EXPECT_EQ("([(* p)] ++)",          parse("(*p)++"));
+  EXPECT_EQ("(([(a | b)] << 2) >> 1)", parse("(a | b) << 2 >> 1"));
+  EXPECT_EQ("f(a, {b = c}, g())[0].m->n", parse("f(a, b = c, g())[0].m->n"));
+  EXPECT_EQ("(\"ab\" \"cd\" + 1)",   parse("\"ab\" \"cd\" + 1"));
+  EXPECT_EQ("((0x10 * 1.5f) - 'c')", parse("0x10 * 1.5f - 'c'"));
+
+  // Comments, newlines and splices between tokens
+  EXPECT_EQ("(a + (b * c))",         parse("a /* x */ +\n  b // y\n * \\\n c"));
+
+  // Takes the longest expression that parses and stops there.
+  p.load("a + b; c");
+  auto e = p.take_expression();
+  EXPECT_EQ("a + b", std::string(e->span.begin, e->span.end));
+  EXPECT_EQ(';', *p.cursor);
+
+  p.load("a + )");
+  e = p.take_expression();
+  EXPECT_EQ("a", std::string(e->span.begin, e->span.end));
+  EXPECT_EQ(p.source_start + 1, p.cursor);
+
+  // Nothing here - no node, cursor unmoved.
+  EXPECT_EQ("<none>", parse(") + a"));
+  EXPECT_EQ("<none>", parse("int"));
+  p.load("  += 1");
+  EXPECT_EQ(nullptr, p.take_expression());
+  EXPECT_EQ(p.source_start, p.cursor);
+
+  // Spans cover first token to last token, no surrounding whitespace.
+  p.load("  x = y  ;");
+  e = p.take_expression();
+  EXPECT_EQ("x = y", std::string(e->span.begin, e->span.end));
+
+  // Arguments are assignment expressions, so a top-level comma separates them.
+  p.load("(a, b)");
+  auto args = p.take_argument_list();
+  EXPECT_NE(nullptr, args);
+  EXPECT_EQ(args->arg_head->next, args->arg_tail);
+  EXPECT_EQ(args->arg_tail->prev, args->arg_head);
+
+  // Deep left-leaning chains go round the loop instead of recursing.
+  std::string chain = "x";
+  for (int i = 0; i < 100000; i++) chain += " + x";
+  p.load(chain);
+  e = p.take_expression();
+  EXPECT_EQ(chain.size(), size_t(e->span.size()));
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_work_pool() {
+  TEST_INIT();
+
+  // Tasks that push more tasks still get waited on.
+  WorkPool pool(4);
+  std::atomic<int> count = 0;
+  for (int i = 0; i < 100; i++) {
+    pool.push([&pool, &count](int thread) {
+      count++;
+      pool.push([&count](int thread) { count++; });
+    });
+  }
+  pool.wait();
+  EXPECT_EQ(200, count.load());
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Chunked lexing has to match lex_all exactly, however badly the chunk
+// boundaries land - in the middle of strings, comments, splices, tokens.
+
+TestResults test_lex_parallel() {
+  TEST_INIT();
+
+  const char* pieces[] = {
+    "int", " ", "x", "=", "0x1234", ";", "\n", "\"a string with /* inside */\"",
+    "/* a comment with \"quotes\" */", "// line comment\n", "\\\n", "'c'",
+    "\"esc\\\"aped\"", "    ", "foo_bar_baz", "1.5e10", "+=", "->", "(", ")",
+  };
+  int piece_count = sizeof(pieces) / sizeof(pieces[0]);
+
+  WorkPool pool(4);
+  uint32_t seed = 7;
+
+  for (int rep = 0; rep < 50; rep++) {
+    std::string source;
+    int len = 20 + rep * 20;
+    for (int i = 0; i < len; i++) {
+      seed = seed * 1664525 + 1013904223;
+      source += pieces[(seed >> 16) % piece_count];
+    }
+    // Every so often make the tail unlexable.
+    if (rep % 10 == 9) source.insert(source.size() / 2, "\x01");
+
+    TokenBuffer serial;
+    bool serial_ok = lex_all(source.c_str(), source.size(), serial);
+
+    for (size_t chunk : { 1, 7, 64, 333, 4096 }) {
+      TokenBuffer parallel;
+      bool parallel_ok = lex_all_parallel(source.c_str(), source.size(), parallel, pool, chunk);
+      EXPECT_EQ(serial_ok, parallel_ok);
+      EXPECT_TRUE(serial.types == parallel.types);
+      EXPECT_TRUE(serial.ends == parallel.ends);
+    }
+  }
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Feeds text through a pipe from another thread, the way cpp -E output comes in.
+
+struct PipeFeeder {
+  PipeFeeder(const std::string& text) {
+    int fds[2];
+    pipe(fds);
+    fd = fds[0];
+    writer = std::thread([text, out = fds[1]] {
+      // Odd-sized writes so reads come back short and ragged.
+      for (size_t i = 0; i < text.size(); i += 77) {
+        write(out, text.data() + i, std::min(size_t(77), text.size() - i));
+      }
+      close(out);
+    });
+  }
+
+  ~PipeFeeder() {
+    writer.join();
+    close(fd);
+  }
+
+  int fd;
+  std::thread writer;
+};
+
+TestResults test_stream() {
+  TEST_INIT();
+
+  const char* pieces[] = {
+    "int", " ", "x", "=", "0x1234", ";", "\n", "\"a string with /* inside */\"",
+    "/* a comment with \"quotes\" */", "// line comment\n", "\\\n", "'c'",
+    "...", "..", "%:%:", "1.5e+10", "+=", "->", "(", ")", "#include <stdio.h>\n",
+  };
+  int piece_count = sizeof(pieces) / sizeof(pieces[0]);
+
+  std::string source;
+  uint32_t seed = 11;
+  for (int i = 0; i < 3000; i++) {
+    seed = seed * 1664525 + 1013904223;
+    source += pieces[(seed >> 16) % piece_count];
+  }
+  // One token much longer than the window.
+  source += "/*" + std::string(5000, '*') + "*/\n";
+
+  TokenBuffer whole;
+  EXPECT_TRUE(lex_all(source.c_str(), source.size(), whole));
+
+  for (size_t window : { 1, 13, 64, 4096, 1 << 20 }) {
+    PipeFeeder feed(source);
+    StreamLexer lexer;
+    EXPECT_TRUE(lexer.open(feed.fd, window));
+
+    TokenBuffer streamed;
+    while (lexer.next()) {
+      for (size_t i = 0; i < lexer.tokens.size(); i++) {
+        streamed.push(LexType(lexer.tokens.types[i]), uint32_t(lexer.offset + lexer.tokens.ends[i]));
+      }
+    }
+    EXPECT_FALSE(lexer.failed());
+    EXPECT_EQ(source.size(), lexer.bytes);
+    EXPECT_TRUE(whole.types == streamed.types);
+    EXPECT_TRUE(whole.ends == streamed.ends);
+  }
+
+  // Lex errors come out at the same offset, and tokens over max_token fail.
+  {
+    uint32_t split = whole.ends[300];
+    PipeFeeder feed(source.substr(0, split) + "\x01" + source.substr(split));
+    StreamLexer lexer;
+    lexer.open(feed.fd, 64);
+    while (lexer.next()) {}
+    EXPECT_TRUE(lexer.failed());
+    EXPECT_EQ(split, lexer.error_offset);
+  }
+  {
+    PipeFeeder feed("x /*" + std::string(1000, ' '));
+    StreamLexer lexer;
+    lexer.open(feed.fd, 64, 256);
+    while (lexer.next()) {}
+    EXPECT_TRUE(lexer.failed());
+    EXPECT_EQ(2, lexer.error_offset);
+  }
+
+  // The streaming parser sees the same top-level nodes as a whole-file parse,
+  // and stops in the same place.
+  Parser whole_parser;
+  whole_parser.load(source);
+  auto unit = whole_parser.take_translation_unit();
+  EXPECT_TRUE(unit.has_value());
+  bool whole_ok = whole_parser.cursor == whole_parser.source_end;
+
+  std::vector<std::pair<uint64_t, size_t>> expected;
+  for (auto n : unit.value()->children) {
+    expected.push_back({n->span.begin - whole_parser.source_start, n->span.size()});
+  }
+
+  for (size_t window : { 1, 13, 64, 100, 4096 }) {
+    PipeFeeder feed(source);
+    Parser p;
+    std::vector<std::pair<uint64_t, size_t>> nodes;
+    bool ok = p.parse_stream(feed.fd, [&](PNode* node, uint64_t offset) {
+      nodes.push_back({offset, node->span.size()});
+    }, window);
+    EXPECT_EQ(whole_ok, ok);
+    EXPECT_TRUE(expected == nodes);
+  }
+
+  // #include paths much longer than stream_lookahead still come out whole
+  // when a window cuts them.
+  std::string includes;
+  for (int i = 0; i < 50; i++) {
+    includes += "#include <some/rather/long/include/path/header_" + std::to_string(i) + ".h>\n";
+    includes += "int x" + std::to_string(i) + ";\n";
+  }
+
+  for (size_t window : { 1, 13, 64, 100, 4096 }) {
+    PipeFeeder feed(includes);
+    Parser p;
+    int include_count = 0;
+    bool ok = p.parse_stream(feed.fd, [&](PNode* node, uint64_t offset) {
+      if (dynamic_cast<PPreprocInclude*>(node)) include_count++;
+    }, window);
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(50, include_count);
+  }
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_scan_corpus() {
+  TEST_INIT();
+
+  char dir[] = "/tmp/parseroni_corpus_XXXXXX";
+  EXPECT_NE(nullptr, mkdtemp(dir));
+  std::string base = dir;
+  mkdir((base + "/sub").c_str(), 0700);
+
+  std::string big;
+  for (int i = 0; i < 1000; i++) big += "int x" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+
+  EXPECT_TRUE(write_file(base + "/a.c",       "int main() { return 0; }\n"));
+  EXPECT_TRUE(write_file(base + "/sub/b.h",   big));
+  EXPECT_TRUE(write_file(base + "/sub/c.cpp", "int bad = \x01;\n"));
+  EXPECT_TRUE(write_file(base + "/notes.txt", "not source"));
+
+  CorpusOptions one;
+  one.threads = 1;
+  auto s1 = scan_corpus({base}, one);
+
+  CorpusOptions many;
+  many.threads = 4;
+  auto s4 = scan_corpus({base}, many);
+
+  EXPECT_EQ(4u, s1.total_files);
+  EXPECT_EQ(3u, s1.source_files);
+  EXPECT_EQ(1u, s1.failed_files);
+  EXPECT_EQ(3u, s1.files.size());
+  EXPECT_EQ(base + "/a.c", s1.files[0].path);
+  EXPECT_FALSE(s1.files[2].ok);
+  EXPECT_EQ(10u, s1.files[2].error_offset);
+
+  // Same answers no matter how the work was split up.
+  EXPECT_EQ(s1.total_bytes,  s4.total_bytes);
+  EXPECT_EQ(s1.total_tokens, s4.total_tokens);
+  EXPECT_EQ(0, memcmp(s1.hit_counts, s4.hit_counts, sizeof(s1.hit_counts)));
+  for (size_t i = 0; i < s1.files.size() && i < s4.files.size(); i++) {
+    EXPECT_EQ(s1.files[i].path,   s4.files[i].path);
+    EXPECT_EQ(s1.files[i].tokens, s4.files[i].tokens);
+  }
+
+  std::filesystem::remove_all(base);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_token_cache() {
+  TEST_INIT();
+
+  // Published XXH64 test vectors.
+  EXPECT_EQ(0xEF46DB3751D8E999ull, hash64("", 0));
+  EXPECT_EQ(0x44BC2CF5AD770999ull, hash64("abc", 3));
+  const char* long_text = "Nobody inspects the spammish repetition";
+  EXPECT_EQ(0xFBCEA83C8A378BF1ull, hash64(long_text, strlen(long_text)));
+
+  char dir[] = "/tmp/parseroni_cache_XXXXXX";
+  EXPECT_NE(nullptr, mkdtemp(dir));
+  std::string base = dir;
+
+  TokenCache cache;
+  EXPECT_TRUE(cache.open(base + "/cache"));
+
+  std::string source = "int main() { return 0; } /* done */\n";
+  TokenBuffer tokens;
+  lex_all(source.c_str(), source.size(), tokens);
+  auto hash = hash64(source.data(), source.size());
+
+  CachedTokens cached;
+  EXPECT_FALSE(cache.lookup(hash, source.size(), cached));
+  EXPECT_TRUE(cache.store(hash, source.size(), tokens, true, 0));
+  EXPECT_TRUE(cache.lookup(hash, source.size(), cached));
+  EXPECT_EQ(tokens.size(), cached.size());
+  EXPECT_TRUE(cached.ok);
+  for (size_t i = 0; i < tokens.size(); i++) {
+    EXPECT_EQ(tokens.types[i], cached.types[i]);
+    EXPECT_EQ(tokens.ends[i], cached.ends[i]);
+  }
+
+  // Same hash, different size - not ours.
+  CachedTokens other;
+  EXPECT_FALSE(cache.lookup(hash, source.size() + 1, other));
+
+  // Second scan of an unchanged tree lexes nothing and gets the same answers.
+  mkdir((base + "/src").c_str(), 0700);
+  EXPECT_TRUE(write_file(base + "/src/a.c", "int a = 1;\n"));
+  EXPECT_TRUE(write_file(base + "/src/b.c", "int b = 2; // two\n"));
+  EXPECT_TRUE(write_file(base + "/src/c.c", "int bad = \x01;\n"));
+
+  CorpusOptions options;
+  options.cache_dir = base + "/cache";
+  auto cold = scan_corpus({base + "/src"}, options);
+  auto warm = scan_corpus({base + "/src"}, options);
+
+  EXPECT_EQ(0u, cold.cache_hits);
+  EXPECT_EQ(3u, warm.cache_hits);
+  EXPECT_EQ(cold.total_tokens, warm.total_tokens);
+  EXPECT_EQ(cold.failed_files, warm.failed_files);
+  EXPECT_EQ(0, memcmp(cold.hit_counts, warm.hit_counts, sizeof(cold.hit_counts)));
+  EXPECT_EQ(cold.files[2].error_offset, warm.files[2].error_offset);
+
+  // Only the edited file gets lexed again.
+  EXPECT_TRUE(write_file(base + "/src/b.c", "int b = 3; // three\n"));
+  auto edited = scan_corpus({base + "/src"}, options);
+  EXPECT_EQ(2u, edited.cache_hits);
+  EXPECT_FALSE(edited.files[1].cached);
+
+  std::filesystem::remove_all(base);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
+TestResults test_include_graph() {
+  TEST_INIT();
+
+  char dir[] = "/tmp/parseroni_incl_XXXXXX";
+  EXPECT_NE(nullptr, mkdtemp(dir));
+  std::string base = dir;
+  mkdir((base + "/src").c_str(), 0700);
+  mkdir((base + "/inc").c_str(), 0700);
+
+  // Commented-out and quoted #includes aren't edges.
+  EXPECT_TRUE(write_file(base + "/src/a.c",
+    "#include \"common.h\"\n"
+    "#include <stdio.h>\n"
+    "#include <lib.h>\n"
+    "/* #include \"fake.h\" */\n"
+    "const char* s = \"#include \\\"fake.h\\\"\";\n"));
+  EXPECT_TRUE(write_file(base + "/src/b.c", "// b\n  #include \"common.h\"\n"));
+  EXPECT_TRUE(write_file(base + "/src/common.h", "#include \"cycle1.h\"\n"));
+  EXPECT_TRUE(write_file(base + "/src/cycle1.h", "#include \"cycle2.h\"\n"));
+  EXPECT_TRUE(write_file(base + "/src/cycle2.h", "#include \"cycle1.h\"\n"));
+  EXPECT_TRUE(write_file(base + "/inc/lib.h", "#include \"common.h\"\n"));
+
+  IncludeOptions options;
+  options.search_dirs = { base + "/inc", base + "/src" };
+  options.threads = 4;
+  auto graph = build_include_graph({base + "/src/a.c", base + "/src/b.c"}, options);
+
+  EXPECT_EQ(6u, graph.nodes.size());
+  EXPECT_EQ(7u, graph.edge_count);
+  EXPECT_EQ(1u, graph.unresolved_count);
+
+  auto a      = graph.find(base + "/src/a.c");
+  auto b      = graph.find(base + "/src/b.c");
+  auto common = graph.find(base + "/src/common.h");
+  auto cycle1 = graph.find(base + "/src/cycle1.h");
+  auto cycle2 = graph.find(base + "/src/cycle2.h");
+  auto lib    = graph.find(base + "/inc/lib.h");
+  EXPECT_NE(IncludeGraph::unresolved, a);
+  EXPECT_NE(IncludeGraph::unresolved, common);
+  EXPECT_NE(IncludeGraph::unresolved, lib);
+  EXPECT_EQ(IncludeGraph::unresolved, graph.find(base + "/src/fake.h"));
+
+  EXPECT_TRUE(graph.nodes[a].root);
+  EXPECT_FALSE(graph.nodes[common].root);
+
+  // Included three times, parsed once.
+  EXPECT_EQ(1u, graph.nodes[common].includes.size());
+
+  auto& a_includes = graph.nodes[a].includes;
+  EXPECT_EQ(3u, a_includes.size());
+  EXPECT_EQ(common, a_includes[0].target);
+  EXPECT_FALSE(a_includes[0].angled);
+  EXPECT_EQ(IncludeGraph::unresolved, a_includes[1].target);
+  EXPECT_EQ("stdio.h", a_includes[1].name);
+  EXPECT_EQ(lib, a_includes[2].target);
+  EXPECT_TRUE(a_includes[2].angled);
+  EXPECT_EQ(3u, a_includes[2].line);
+  EXPECT_EQ(2u, graph.nodes[b].includes[0].line);
+
+  EXPECT_EQ((std::vector<uint32_t>{ lib, common, cycle1, cycle2 }), graph.reachable(a));
+  // A cycle reaches itself.
+  EXPECT_EQ((std::vector<uint32_t>{ cycle1, cycle2 }), graph.reachable(cycle1));
+  EXPECT_EQ((std::vector<uint32_t>{ lib, a, b }), graph.reachable(common, true));
+  EXPECT_EQ(6u, graph.reachable(cycle2, true).size());
+
+  // Same graph whatever the thread count.
+  options.threads = 1;
+  auto serial = build_include_graph({base + "/src/b.c", base + "/src/a.c"}, options);
+
+  auto edges = [](const IncludeGraph& g) {
+    char* buf = nullptr;
+    size_t size = 0;
+    FILE* f = open_memstream(&buf, &size);
+    g.write_edges(f);
+    fclose(f);
+    std::string result(buf, size);
+    free(buf);
+    return result;
+  };
+  EXPECT_EQ(edges(graph), edges(serial));
+
+  std::filesystem::remove_all(base);
+
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+
 TestResults test_take_str() {
   TEST_INIT();
 
@@ -631,7 +2107,58 @@ R"(
   else {
   }
 
-  delete n;
+  TEST_DONE();
+}
+
+//------------------------------------------------------------------------------
+// Probes are per-thread, so lexing the same text on every worker has to add up
+// to exactly workers * one run.
+
+TestResults test_instrument() {
+  TEST_INIT();
+
+  const char* text = "int x = 10; // comment\nfoo(\"bar\", 'c');\n";
+
+#ifdef PARSERONI_INSTRUMENT
+  auto find = [](const char* name) {
+    for (auto& s : instrument_snapshot()) if (s.name == name) return s;
+    return ProbeStats();
+  };
+
+  instrument_reset();
+  TokenBuffer tokens;
+  EXPECT_TRUE(lex_all(text, strlen(text), tokens));
+
+  auto single = find("scan_identifier");
+  EXPECT_NE(0u, single.attempts);
+  EXPECT_NE(0u, single.hits);
+  EXPECT_TRUE(single.hits <= single.attempts);
+
+  instrument_reset();
+  WorkPool pool(4);
+  for (int i = 0; i < pool.thread_count(); i++) {
+    pool.push([text](int) {
+      TokenBuffer tokens;
+      lex_all(text, strlen(text), tokens);
+    });
+  }
+  pool.wait();
+
+  auto multi = find("scan_identifier");
+  EXPECT_EQ(single.attempts * pool.thread_count(), multi.attempts);
+  EXPECT_EQ(single.hits * pool.thread_count(), multi.hits);
+
+  Parser p;
+  p.load(text);
+  instrument_reset();
+  while (p.take_toplevel());
+  EXPECT_NE(0u, find("take_token").hits);
+#else
+  // With probes compiled out there's nothing to count.
+  TokenBuffer tokens;
+  EXPECT_TRUE(lex_all(text, strlen(text), tokens));
+  EXPECT_TRUE(instrument_snapshot().empty());
+#endif
 
   TEST_DONE();
 }
@@ -649,6 +2176,29 @@ int main(int argc, char** argv) {
 
   TestResults r;
   r << test_thingy();
+  r << test_tokens();
+  r << test_take_matcher();
+  r << test_lex_dispatch();
+  r << test_keywords();
+  r << test_numbers();
+  r << test_floats();
+  r << test_token_buffer();
+  r << test_scanners();
+  r << test_translate();
+  r << test_line_index();
+  r << test_load_file();
+  r << test_arena();
+  r << test_checkpoint();
+  r << test_memo();
+  r << test_apply_edit();
+  r << test_expressions();
+  r << test_work_pool();
+  r << test_lex_parallel();
+  r << test_stream();
+  r << test_scan_corpus();
+  r << test_token_cache();
+  r << test_include_graph();
+  r << test_instrument();
 
 #if 0
   r << test_basic();